@@ -40,20 +40,98 @@ function updateScoreboard(idx, name, score) {
   update("scoreboard-player-score-" + idx, score.toFixed());
 }
 
+function createLayer(width, height) {
+  let layer = document.createElement("canvas");
+  layer.width = Math.max(1, Math.ceil(width));
+  layer.height = Math.max(1, Math.ceil(height));
+  return layer;
+}
+
 class CanvasManager {
-  constructor(htmlCanvas) {
+  constructor(htmlCanvas, backgroundCanvas) {
     this.canvas = htmlCanvas;
     const fullSize = Math.min(this.canvas.width, this.canvas.height);
 
     this.margin = fullSize * 0.02;
     this.innerSize = fullSize - 2 * this.margin;
     this.ctx = this.canvas.getContext("2d");
-    this.lastDrawTimes = [Date.now()];
+    this.lastTickTimes = [Date.now()];
     const smallFontSize = this.getSmallFontSize();
-    this.verySmallFont = (0.65 * smallFontSize).toFixed() + "px " + font;
+    this.verySmallFontSize = 0.65 * smallFontSize;
+    this.verySmallFont = this.verySmallFontSize.toFixed() + "px " + font;
     this.smallFont = smallFontSize.toFixed() + "px " + font;
     this.mediumFont = (1.5 * smallFontSize).toFixed() + "px " + font;
     this.bigFont = (2.5 * smallFontSize).toFixed() + "px " + font;
+
+    // what doesn't change from one frame to the next is drawn once:
+    // the border in a canvas stacked under this one, the players and
+    // their names in offscreen canvases copied in each frame
+    this.useLayers = true;
+    this.background = backgroundCanvas;
+    this.backgroundVisible = false;
+    this.drawLimits(this.background.getContext("2d"));
+    // fill style and size -> pre-rendered player disc
+    this.sprites = new Map();
+    // name -> pre-rendered label, dropped when the name disappears
+    this.labels = new Map();
+    this.usedLabels = new Set();
+    // the labels rendered before the web font is loaded use a fallback
+    if (document.fonts) {
+      document.fonts.addEventListener("loadingdone", () => this.labels.clear());
+    }
+  }
+
+  setBackgroundVisible(visible) {
+    if (visible !== this.backgroundVisible) {
+      this.background.style.visibility = visible ? "visible" : "hidden";
+      this.backgroundVisible = visible;
+    }
+  }
+
+  getSprite(fillStyle, playerSize) {
+    const key = fillStyle + " " + playerSize;
+    let sprite = this.sprites.get(key);
+    if (sprite !== undefined) {
+      return sprite;
+    }
+
+    // room for the outline around the disc
+    const center = Math.ceil(playerSize / 2 + 1);
+    sprite = createLayer(2 * center, 2 * center);
+    const spriteCtx = sprite.getContext("2d");
+    this.drawDisc(spriteCtx, fillStyle, center, center, playerSize);
+    this.sprites.set(key, sprite);
+    return sprite;
+  }
+
+  getLabel(name) {
+    this.usedLabels.add(name);
+    let label = this.labels.get(name);
+    if (label !== undefined) {
+      return label;
+    }
+
+    this.ctx.font = this.verySmallFont;
+    const width = this.ctx.measureText(name).width;
+    // room for the descenders below the baseline
+    label = createLayer(width + 2, 1.5 * this.verySmallFontSize);
+    const labelCtx = label.getContext("2d");
+    labelCtx.font = this.verySmallFont;
+    labelCtx.textAlign = "center";
+    labelCtx.textBaseline = "bottom";
+    labelCtx.fillStyle = "white";
+    labelCtx.fillText(name, label.width / 2, label.height);
+    this.labels.set(name, label);
+    return label;
+  }
+
+  dropUnusedLabels() {
+    for (const name of this.labels.keys()) {
+      if (!this.usedLabels.has(name)) {
+        this.labels.delete(name);
+      }
+    }
+    this.usedLabels.clear();
   }
 
   getSmallFontSize() {
@@ -69,12 +147,15 @@ class CanvasManager {
     return fontsize;
   }
 
+  countTick() {
+    this.lastTickTimes.push(Date.now());
+    this.lastTickTimes = this.lastTickTimes.slice(-10);
+  }
+
   drawTicksPerSecond() {
-    this.lastDrawTimes.push(Date.now());
-    this.lastDrawTimes = this.lastDrawTimes.slice(-10);
     const dt =
-      this.lastDrawTimes[this.lastDrawTimes.length - 1] - this.lastDrawTimes[0];
-    const tps = ((this.lastDrawTimes.length - 1) * 1000.0) / dt;
+      this.lastTickTimes[this.lastTickTimes.length - 1] - this.lastTickTimes[0];
+    const tps = ((this.lastTickTimes.length - 1) * 1000.0) / dt;
     const tpsStr = Math.round(tps).toFixed().padStart(3, " ");
 
     this.ctx.font = this.verySmallFont;
@@ -88,17 +169,35 @@ class CanvasManager {
     );
   }
 
-  drawLimits() {
-    this.ctx.strokeStyle = "red";
-    this.ctx.lineWidth = 1;
-    this.ctx.beginPath();
-    this.ctx.setLineDash([5, 5]);
-    this.ctx.moveTo(this.margin, this.margin);
-    this.ctx.lineTo(this.margin + this.innerSize, this.margin);
-    this.ctx.lineTo(this.margin + this.innerSize, this.margin + this.innerSize);
-    this.ctx.lineTo(this.margin, this.margin + this.innerSize);
-    this.ctx.lineTo(this.margin, this.margin);
-    this.ctx.stroke();
+  drawLimits(ctx) {
+    ctx.strokeStyle = "red";
+    ctx.lineWidth = 1;
+    ctx.beginPath();
+    ctx.setLineDash([5, 5]);
+    ctx.moveTo(this.margin, this.margin);
+    ctx.lineTo(this.margin + this.innerSize, this.margin);
+    ctx.lineTo(this.margin + this.innerSize, this.margin + this.innerSize);
+    ctx.lineTo(this.margin, this.margin + this.innerSize);
+    ctx.lineTo(this.margin, this.margin);
+    ctx.stroke();
+  }
+
+  drawBackground() {
+    this.setBackgroundVisible(this.useLayers);
+    if (!this.useLayers) {
+      this.drawLimits(this.ctx);
+    }
+  }
+
+  drawFrame(players, inputRefX, inputRefY) {
+    this.clear(true);
+    this.drawBackground();
+    this.drawTicksPerSecond();
+    this.drawInputRef(inputRefX, inputRefY);
+    for (let player of players) {
+      this.drawPlayer(player);
+    }
+    this.dropUnusedLabels();
   }
 
   drawScore(player) {
@@ -136,39 +235,31 @@ class CanvasManager {
     this.ctx.stroke();
 
     // draw player
-    this.ctx.beginPath();
+    let fillStyle = "rgb(255, 100, 0)";
     if (player.is_me) {
-      this.ctx.fillStyle = "rgb(0, 255, 0)";
+      fillStyle = "rgb(0, 255, 0)";
     } else if (!player.alive) {
-      this.ctx.fillStyle = "rgb(50, 50, 50)";
+      fillStyle = "rgb(50, 50, 50)";
     } else if (!player.fake) {
-      this.ctx.fillStyle = "rgb(255, 0, 0)";
+      fillStyle = "rgb(255, 0, 0)";
+    }
+    if (this.useLayers) {
+      const sprite = this.getSprite(fillStyle, playerSize);
+      this.ctx.drawImage(
+        sprite,
+        Math.round(this.margin + x - sprite.width / 2),
+        Math.round(this.margin + y - sprite.height / 2)
+      );
     } else {
-      this.ctx.fillStyle = "rgb(255, 100, 0)";
+      this.drawDisc(
+        this.ctx,
+        fillStyle,
+        this.margin + x,
+        this.margin + y,
+        playerSize
+      );
     }
 
-    this.strokeStyle = "black";
-    this.ctx.arc(
-      this.margin + x,
-      this.margin + y,
-      playerSize / 2,
-      0,
-      2 * Math.PI
-    );
-    this.ctx.stroke();
-    this.ctx.fill();
-
-    this.ctx.beginPath();
-    this.ctx.fillStyle = "black";
-    this.ctx.arc(
-      this.margin + x,
-      this.margin + y,
-      playerSize / 5,
-      0,
-      2 * Math.PI
-    );
-    this.ctx.fill();
-
     // draw player score
     this.ctx.font = this.verySmallFont;
     this.ctx.textAlign = "center";
@@ -176,12 +267,37 @@ class CanvasManager {
     this.ctx.fillStyle = "white";
     let scoreStr = player.score.toFixed();
     this.ctx.fillText(scoreStr, this.margin + x, this.margin + y + playerSize);
-    this.ctx.textBaseline = "bottom";
-    this.ctx.fillText(
-      player.name,
-      this.margin + x,
-      this.margin + y - playerSize
-    );
+    if (this.useLayers) {
+      const label = this.getLabel(player.name);
+      this.ctx.drawImage(
+        label,
+        Math.round(this.margin + x - label.width / 2),
+        Math.round(this.margin + y - playerSize - label.height)
+      );
+    } else {
+      this.ctx.textBaseline = "bottom";
+      this.ctx.fillText(
+        player.name,
+        this.margin + x,
+        this.margin + y - playerSize
+      );
+    }
+  }
+
+  drawDisc(ctx, fillStyle, x, y, playerSize) {
+    ctx.strokeStyle = "rgb(150, 150, 150)";
+    ctx.lineWidth = 1.5;
+    ctx.setLineDash([]);
+    ctx.beginPath();
+    ctx.fillStyle = fillStyle;
+    ctx.arc(x, y, playerSize / 2, 0, 2 * Math.PI);
+    ctx.stroke();
+    ctx.fill();
+
+    ctx.beginPath();
+    ctx.fillStyle = "black";
+    ctx.arc(x, y, playerSize / 5, 0, 2 * Math.PI);
+    ctx.fill();
   }
 
   drawInputRef(x, y) {
@@ -239,6 +355,53 @@ class CanvasManager {
     );
   }
 
+  drawQueue(position, estimatedWait) {
+    this.clear();
+    this.ctx.font = this.mediumFont;
+    this.ctx.textAlign = "center";
+    this.ctx.textBaseline = "bottom";
+    this.ctx.fillStyle = "white";
+    this.ctx.fillText(
+      "ALL WORLDS ARE FULL",
+      this.margin + this.innerSize / 2,
+      this.margin + this.innerSize / 2 - 5
+    );
+
+    let waitStr = "";
+    if (estimatedWait !== null) {
+      waitStr = ", about " + Math.ceil(estimatedWait).toFixed() + "s";
+    }
+    this.ctx.font = this.smallFont;
+    this.ctx.textBaseline = "top";
+    this.ctx.fillText(
+      "position in queue: " + position + waitStr,
+      this.margin + this.innerSize / 2,
+      this.margin + this.innerSize / 2 + 5
+    );
+  }
+
+  drawBenchResults(results) {
+    this.clear();
+    this.ctx.font = this.verySmallFont;
+    this.ctx.textAlign = "start";
+    this.ctx.textBaseline = "top";
+    this.ctx.fillStyle = "white";
+    const lineHeight = 1.5 * this.verySmallFontSize;
+    let y = this.margin + 10;
+    this.ctx.fillText("players layers mean(ms) p95(ms)", this.margin + 10, y);
+    for (const result of results) {
+      y += lineHeight;
+      this.ctx.fillText(
+        result.players.toFixed().padStart(7, " ") +
+          (result.layers ? " yes   " : " no    ") +
+          result.meanMs.padStart(9, " ") +
+          result.p95Ms.padStart(9, " "),
+        this.margin + 10,
+        y
+      );
+    }
+  }
+
   drawError(text) {
     this.clear();
     this.ctx.font = this.mediumFont;
@@ -253,13 +416,18 @@ class CanvasManager {
     );
   }
 
-  clear() {
+  // the border stays shown for the game frames only
+  clear(keepBackground = false) {
     this.ctx.clearRect(0, 0, this.canvas.width, this.canvas.height);
+    if (!keepBackground) {
+      this.setBackgroundVisible(false);
+    }
   }
 }
 
 class GameEngine {
   constructor(url, canvasManager, input, playerId, playerName) {
+    // spectators have no player ID and do not register
     this.playerId = playerId;
     this.playerName = playerName;
     this.inputRefX = null;
@@ -267,6 +435,12 @@ class GameEngine {
     this.gameIsOver = false;
     this.canvas = canvasManager;
     this.input = input;
+    // messages only keep the latest snapshot, it is drawn at the next
+    // animation frame whatever the number of messages received meanwhile
+    this.snapshot = null;
+    this.frameRequest = null;
+    // echoed with the inputs, the server measures the display latency
+    this.displayedTick = null;
 
     this.sock = new WebSocket(url);
 
@@ -303,14 +477,44 @@ class GameEngine {
   onOpen() {
     console.log("Starting communication");
     window.scrollTo(0, 0);
+    if (!this.playerId) {
+      return;
+    }
     this.input.preventDefaultTouchStart = true;
     this.send({
       command: { register: { id: this.playerId, name: this.playerName } },
     });
   }
 
+  requestFrame() {
+    if (this.frameRequest === null) {
+      this.frameRequest = window.requestAnimationFrame(this.onFrame.bind(this));
+    }
+  }
+
+  cancelFrame() {
+    if (this.frameRequest !== null) {
+      window.cancelAnimationFrame(this.frameRequest);
+      this.frameRequest = null;
+    }
+  }
+
+  onFrame() {
+    this.frameRequest = null;
+    const snapshot = this.snapshot;
+    this.snapshot = null;
+    if (snapshot === null) {
+      return;
+    }
+
+    this.updateScoreboard(snapshot.players);
+    this.canvas.drawFrame(snapshot.players, this.inputRefX, this.inputRefY);
+    this.displayedTick = snapshot.tick;
+  }
+
   onClose(event) {
     console.log("Closing communication");
+    this.cancelFrame();
     this.input.preventDefaultTouchStart = false;
     if (event.reason) {
       this.canvas.drawError(event.reason);
@@ -321,27 +525,32 @@ class GameEngine {
 
   onError(error) {
     console.error("WebSocket error", error);
+    this.cancelFrame();
     this.input.preventDefaultTouchStart = false;
     this.canvas.drawError("CONNECTION ERROR");
   }
 
   onMessage(msg) {
+    if (msg.queue) {
+      this.cancelFrame();
+      this.canvas.drawQueue(msg.queue.position, msg.queue.estimated_wait);
+      return;
+    }
+
     if (msg.game_over) {
       this.gameOver();
       return;
     }
 
-    this.updateScoreboard(msg.players);
-    this.canvas.clear();
-    this.canvas.drawTicksPerSecond();
-    this.canvas.drawLimits();
-    this.canvas.drawInputRef(this.inputRefX, this.inputRefY);
-    for (let player of msg.players) {
-      this.canvas.drawPlayer(player);
-    }
+    this.canvas.countTick();
+    this.snapshot = msg;
+    this.requestFrame();
   }
 
   onInput(input) {
+    if (!this.playerId) {
+      return;
+    }
     if (this.gameIsOver) {
       if (input.startInput) {
         this.restartGame();
@@ -358,7 +567,11 @@ class GameEngine {
       return;
     }
 
-    this.send({ input: input });
+    if (this.displayedTick === null) {
+      this.send({ input: input });
+    } else {
+      this.send({ input: input, tick: this.displayedTick });
+    }
   }
 
   send(msg) {
@@ -366,6 +579,8 @@ class GameEngine {
   }
 
   gameOver() {
+    // drawn over the last frame
+    this.cancelFrame();
     this.canvas.drawGameOver();
     this.gameIsOver = true;
   }
@@ -389,16 +604,120 @@ class GameEngine {
   }
 }
 
+// Renders synthetic worlds, with and without the offscreen layers, and
+// reports the time spent drawing each frame. Open the client with ?bench
+const benchPlayerCounts = [8, 100];
+const benchFrames = 300;
+
+class RenderBench {
+  constructor(canvasManager) {
+    this.canvas = canvasManager;
+    this.runs = [];
+    for (const playerCount of benchPlayerCounts) {
+      for (const useLayers of [false, true]) {
+        this.runs.push({ playerCount, useLayers, drawTimes: [] });
+      }
+    }
+    this.results = [];
+  }
+
+  start() {
+    this.startRun(this.runs.shift());
+  }
+
+  startRun(run) {
+    this.run = run;
+    this.canvas.useLayers = run.useLayers;
+    this.players = [];
+    for (let idx = 0; idx < run.playerCount; ++idx) {
+      this.players.push({
+        name: "player " + idx,
+        x: Math.random(),
+        y: Math.random(),
+        dx: (Math.random() - 0.5) / 100,
+        dy: (Math.random() - 0.5) / 100,
+        ddx: maxDd * (2 * Math.random() - 1),
+        ddy: maxDd * (2 * Math.random() - 1),
+        size: 0.05,
+        score: 1000 * Math.random(),
+        best_score: 0,
+        is_me: idx == 0,
+        alive: true,
+        fake: idx != 0,
+      });
+    }
+    window.requestAnimationFrame(this.onFrame.bind(this));
+  }
+
+  movePlayers() {
+    for (let player of this.players) {
+      player.x += player.dx;
+      player.y += player.dy;
+      if (player.x < 0 || player.x > 1) {
+        player.dx = -player.dx;
+      }
+      if (player.y < 0 || player.y > 1) {
+        player.dy = -player.dy;
+      }
+      player.score += 1;
+      player.best_score = Math.max(player.best_score, player.score);
+    }
+  }
+
+  onFrame() {
+    this.movePlayers();
+    this.canvas.countTick();
+    const start = performance.now();
+    this.canvas.drawFrame(this.players, null, null);
+    // reading a pixel back rasterizes the frame, most of its cost,
+    // instead of timing the recording of the drawing commands only
+    this.canvas.ctx.getImageData(0, 0, 1, 1);
+    this.run.drawTimes.push(performance.now() - start);
+
+    if (this.run.drawTimes.length < benchFrames) {
+      window.requestAnimationFrame(this.onFrame.bind(this));
+      return;
+    }
+
+    this.results.push(this.summarize(this.run));
+    if (this.runs.length > 0) {
+      this.startRun(this.runs.shift());
+    } else {
+      this.report();
+    }
+  }
+
+  summarize(run) {
+    const times = run.drawTimes.slice().sort((a, b) => a - b);
+    const mean = times.reduce((a, b) => a + b, 0) / times.length;
+    return {
+      players: run.playerCount,
+      layers: run.useLayers,
+      meanMs: mean.toFixed(3),
+      p95Ms: times[Math.floor(0.95 * (times.length - 1))].toFixed(3),
+    };
+  }
+
+  report() {
+    console.table(this.results);
+    this.canvas.drawBenchResults(this.results);
+  }
+}
+
 class GameManager {
   constructor() {
     this.fullSize = Math.min(window.innerWidth, window.innerHeight);
     const horizontal = window.innerWidth > this.fullSize;
 
     this.currentGame = null;
+    this.bench = null;
 
     const canvas = document.getElementById("canvas");
-    canvas.width = window.innerWidth;
-    canvas.height = window.innerHeight;
+    const backgroundCanvas = document.getElementById("background-canvas");
+    for (const c of [canvas, backgroundCanvas]) {
+      c.width = window.innerWidth;
+      c.height = window.innerHeight;
+    }
     const spacer = document.getElementById("spacer-canvas");
     spacer.style.minWidth = this.fullSize + "px";
     spacer.style.minHeight = this.fullSize + "px";
@@ -409,18 +728,48 @@ class GameManager {
     createScoreboard();
 
     this.input = new Input(document, this.fullSize, this.onInput.bind(this));
-    this.canvas = new CanvasManager(canvas);
+    this.canvas = new CanvasManager(canvas, backgroundCanvas);
     this.fillPlayerName();
-    this.canvas.drawWelcome();
+
+    const params = new URLSearchParams(window.location.search);
+    if (params.has("bench")) {
+      this.bench = new RenderBench(this.canvas);
+      this.bench.start();
+      return;
+    }
+
+    const spectatedWorld = this.getSpectatedWorld();
+    if (spectatedWorld !== null) {
+      this.spectate(spectatedWorld);
+    } else {
+      this.canvas.drawWelcome();
+    }
+  }
+
+  spectate(world) {
+    this.currentGame = new GameEngine(
+      this.getWsHref("spectate?world=" + world),
+      this.canvas,
+      this.input,
+      null,
+      null
+    );
+  }
+
+  getSpectatedWorld() {
+    const params = new URLSearchParams(window.location.search);
+    return params.get("spectate");
   }
 
   newGame() {
     const playerName = this.getPlayerName();
+    const playerId = this.getPlayerId();
     this.currentGame = new GameEngine(
-      this.getWsHref(),
+      // the ID lets a router send the player back to the same backend
+      this.getGameWsHref("ws?id=" + playerId),
       this.canvas,
       this.input,
-      this.getPlayerId(),
+      playerId,
       playerName
     );
     this.savePlayerName(playerName);
@@ -434,6 +783,9 @@ class GameManager {
   }
 
   onInput(input) {
+    if (this.bench || this.getSpectatedWorld() !== null) {
+      return;
+    }
     if (
       (!this.currentGame ||
         this.currentGame.sock.readyState == WebSocket.CLOSED) &&
@@ -451,16 +803,29 @@ class GameManager {
     }
   }
 
-  getWsHref() {
+  // ?server=host:port connects the game directly to a backend
+  // terminating TLS itself, without the reverse-proxy
+  getGameWsHref(target) {
+    const params = new URLSearchParams(window.location.search);
+    const server = params.get("server");
+    if (server === null) {
+      return this.getWsHref(target);
+    }
+    return "wss://" + server + "/" + target;
+  }
+
+  getWsHref(target = "ws") {
     let location = window.location.pathname.toString();
     if (location[location.length - 1] == "/") {
       location = location.substring(0, -1);
     }
-    let wsHref = window.location.href.toString().replace(RegExp("^http"), "ws");
+    let wsHref = (window.location.origin + window.location.pathname)
+      .toString()
+      .replace(RegExp("^http"), "ws");
     if (wsHref[wsHref.length - 1] != "/") {
       wsHref += "/";
     }
-    wsHref += "ws";
+    wsHref += target;
     return wsHref;
   }
 
@@ -0,0 +1,84 @@
+// Allocation check: ticks a world in-process, with players joining,
+// leaving and coming back while bots fill the empty places, and counts
+// the heap allocations made meanwhile. The run fails if the ticks or the
+// player registrations allocate once the world is warmed up.
+
+#include <cstdlib>
+#include <vector>
+
+#include <boost/uuid/random_generator.hpp>
+#include <spdlog/spdlog.h>
+
+#include "alloc_counter.h"
+#include "world.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto cycles_envvar = "ALLOC_CHECK_CYCLES";
+
+constexpr int ticks_per_step = 5;
+constexpr std::size_t real_players = world_t::max_players / 2;
+
+void step(world_t& world)
+{
+    for (int i = 0; i < ticks_per_step; ++i) {
+        world.tick();
+    }
+}
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto* mb_cycles = std::getenv(cycles_envvar);
+    const auto cycles = mb_cycles ? std::atoi(mb_cycles) : 50;
+
+    // the world is ticked here rather than by its own loop,
+    // the allocations of the timers are not under test
+    net::io_context ioc{1};
+    auto world = std::make_shared<world_t>(ioc);
+
+    // generated upfront, the generator is not under test
+    boost::uuids::random_generator uuid_generator;
+    std::vector<player_id_t> ids;
+    for (std::size_t i = 0; i < 2 * real_players; ++i) {
+        ids.push_back(uuid_generator());
+    }
+
+    std::vector<player_handle_t> players(real_players);
+    for (std::size_t i = 0; i < real_players; ++i) {
+        players[i] = world->register_player(ids[i], "player");
+    }
+    step(*world);
+
+    start_counting_allocations();
+    for (int cycle = 0; cycle < cycles; ++cycle) {
+        // one player leaves and a bot takes its place, then a player
+        // takes the place back: alternately a new one, using a free
+        // slot, and the one that left before, restored from its reservation
+        const auto idx = static_cast<std::size_t>(cycle) % real_players;
+        players[idx].reset();
+        step(*world);
+
+        const auto round = static_cast<std::size_t>(cycle) / real_players;
+        const auto id_idx = round % 2 == 0 ? idx + real_players : idx;
+        players[idx] = world->register_player(ids[id_idx], "player");
+        step(*world);
+    }
+    const auto allocations = stop_counting_allocations();
+
+    const auto ticks = 2 * cycles * ticks_per_step;
+    if (allocations != 0) {
+        spdlog::error(
+            "FAIL: {} allocations during {} cycles ({} ticks)",
+            allocations,
+            cycles,
+            ticks);
+        return EXIT_FAILURE;
+    }
+    spdlog::info(
+        "PASS: no allocation during {} cycles ({} ticks)", cycles, ticks);
+    return EXIT_SUCCESS;
+}
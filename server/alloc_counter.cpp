@@ -0,0 +1,68 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace sd {
+
+namespace {
+
+bool counting = false;
+std::int64_t allocations = 0;
+
+}
+
+void* counted_alloc(std::size_t size)
+{
+    if (counting) {
+        ++allocations;
+    }
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void start_counting_allocations()
+{
+    allocations = 0;
+    counting = true;
+}
+
+std::int64_t stop_counting_allocations()
+{
+    counting = false;
+    return allocations;
+}
+
+} // sd
+
+void* operator new(std::size_t size)
+{
+    return sd::counted_alloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return sd::counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
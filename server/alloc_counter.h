@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sd {
+
+// Counts the allocations made through operator new between a start and
+// a stop. Only linked in the checks and benchmarks, it replaces the
+// global operator new.
+void start_counting_allocations();
+std::int64_t stop_counting_allocations();
+
+} // sd
@@ -0,0 +1,124 @@
+// State serialization benchmark: compares the messages written by
+// state_writer_t to nlohmann::json::dump(), which must be byte for byte
+// identical, then measures the time and the allocations of both per message.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <boost/uuid/random_generator.hpp>
+#include <spdlog/spdlog.h>
+
+#include "alloc_counter.h"
+#include "state_writer.h"
+#include "world.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto iterations_envvar = "BENCH_ITERATIONS";
+
+// escaping and UTF-8 are part of the comparison
+constexpr std::string_view player_name = "\"bench\"\t\\ player é\x01";
+
+constexpr int numbers_checked = 1'000'000;
+
+// the numbers of the game are few, random bit patterns cover
+// the exponent forms and the shortest digits corner cases
+int check_numbers()
+{
+    std::mt19937_64 rnd_gen{42}; // NOLINT(*-magic-numbers)
+    std::uniform_real_distribution<double> dist{-1e3, 1e3};
+    int mismatches = 0;
+    std::string out;
+    for (int i = 0; i < numbers_checked; ++i) {
+        double value = 0;
+        if (i % 2 == 0) {
+            const auto bits = rnd_gen();
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        else {
+            value = dist(rnd_gen);
+        }
+        out.clear();
+        write_json_number(out, value);
+        const auto expected = nlohmann::json(value).dump();
+        if (out != expected) {
+            if (mismatches++ < 10) { // NOLINT(*-magic-numbers)
+                spdlog::error("number mismatch: {} != {}", out, expected);
+            }
+        }
+    }
+    return mismatches;
+}
+
+template<typename F>
+void measure(std::string_view name, int iterations, F&& encode)
+{
+    std::size_t bytes = 0;
+    start_counting_allocations();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        bytes += encode();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto allocations = stop_counting_allocations();
+
+    const auto ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    spdlog::info(
+        "{}: {} ns/message, {:.1f} allocations/message, {} bytes/message",
+        name,
+        ns / iterations,
+        static_cast<double>(allocations) / iterations,
+        bytes / static_cast<std::size_t>(iterations));
+}
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto* mb_iterations = std::getenv(iterations_envvar);
+    const auto iterations = mb_iterations ? std::atoi(mb_iterations) : 100'000;
+
+    // one real player, bots fill the other places
+    net::io_context ioc{1};
+    auto world = std::make_shared<world_t>(ioc);
+    boost::uuids::random_generator uuid_generator;
+    auto player = world->register_player(uuid_generator(), player_name);
+
+    int mismatches = check_numbers();
+    for (int i = 0; i < iterations; ++i) {
+        world->tick();
+        const auto state = world->encode_state_for_player(player);
+        const auto expected = world->game_state_for_player(player).dump();
+        if (state != expected) {
+            if (mismatches++ < 10) { // NOLINT(*-magic-numbers)
+                spdlog::error("state mismatch:\n{}\n{}", state, expected);
+            }
+        }
+    }
+    if (mismatches != 0) {
+        spdlog::error("FAIL: {} mismatches", mismatches);
+        return EXIT_FAILURE;
+    }
+
+    // the players keep moving between the messages,
+    // the cost of the tick alone is measured first
+    measure("tick", iterations, [&] {
+        world->tick();
+        return std::size_t{0};
+    });
+    measure("nlohmann::json::dump", iterations, [&] {
+        world->tick();
+        return world->game_state_for_player(player).dump().size();
+    });
+    measure("state_writer_t", iterations, [&] {
+        world->tick();
+        return world->encode_state_for_player(player).size();
+    });
+    return EXIT_SUCCESS;
+}
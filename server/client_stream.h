@@ -0,0 +1,157 @@
+#pragma once
+
+#include <utility>
+#include <variant>
+
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+
+#include "config.h"
+
+namespace sd {
+
+// The stream of a player connection, in plain text or over TLS
+// terminated in process. Both are the same type for the sessions and
+// the waiting room, only the handshake differs.
+class client_stream_t {
+public:
+    using executor_type = plain_stream_t::executor_type;
+    using tls_stream_t = beast::ssl_stream<plain_stream_t>;
+
+    explicit client_stream_t(stream_socket_t&& socket)
+        : stream_{std::in_place_type<plain_stream_t>, std::move(socket)}
+    {
+    }
+    client_stream_t(stream_socket_t&& socket, net::ssl::context& tls_context)
+        : stream_{
+            std::in_place_type<tls_stream_t>, std::move(socket), tls_context}
+    {
+    }
+
+    executor_type get_executor() { return plain().get_executor(); }
+
+    // nullptr in plain text
+    tls_stream_t* tls() { return std::get_if<tls_stream_t>(&stream_); }
+    // the TCP or local stream, for its timeouts
+    plain_stream_t& plain()
+    {
+        if (auto* tls_stream = tls()) {
+            return tls_stream->next_layer();
+        }
+        return std::get<plain_stream_t>(stream_);
+    }
+
+    template <typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers)
+    {
+        return std::visit(
+            [&](auto& stream) { return stream.read_some(buffers); },
+            stream_);
+    }
+
+    template <typename MutableBufferSequence>
+    std::size_t read_some(
+        const MutableBufferSequence& buffers,
+        beast::error_code& ec)
+    {
+        return std::visit(
+            [&](auto& stream) { return stream.read_some(buffers, ec); },
+            stream_);
+    }
+
+    template <typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers)
+    {
+        return std::visit(
+            [&](auto& stream) { return stream.write_some(buffers); },
+            stream_);
+    }
+
+    template <typename ConstBufferSequence>
+    std::size_t write_some(
+        const ConstBufferSequence& buffers,
+        beast::error_code& ec)
+    {
+        return std::visit(
+            [&](auto& stream) { return stream.write_some(buffers, ec); },
+            stream_);
+    }
+
+    template <typename MutableBufferSequence, typename ReadHandler>
+    auto async_read_some(
+        const MutableBufferSequence& buffers,
+        ReadHandler&& handler)
+    {
+        return net::async_initiate<
+            ReadHandler,
+            void(beast::error_code, std::size_t)>(
+            [this](auto handler, const MutableBufferSequence& buffers) {
+                std::visit(
+                    [&](auto& stream) {
+                        stream.async_read_some(buffers, std::move(handler));
+                    },
+                    stream_);
+            },
+            handler,
+            buffers);
+    }
+
+    template <typename ConstBufferSequence, typename WriteHandler>
+    auto async_write_some(
+        const ConstBufferSequence& buffers,
+        WriteHandler&& handler)
+    {
+        return net::async_initiate<
+            WriteHandler,
+            void(beast::error_code, std::size_t)>(
+            [this](auto handler, const ConstBufferSequence& buffers) {
+                std::visit(
+                    [&](auto& stream) {
+                        stream.async_write_some(buffers, std::move(handler));
+                    },
+                    stream_);
+            },
+            handler,
+            buffers);
+    }
+
+    // closed by the websocket on timeouts, see beast::close_socket
+    friend void beast_close_socket(client_stream_t& stream)
+    {
+        stream.plain().close();
+    }
+
+    // closing the websocket closes the stream, see websocket/teardown.hpp
+    friend void teardown(
+        beast::role_type role,
+        client_stream_t& stream,
+        beast::error_code& ec)
+    {
+        std::visit(
+            [&](auto& s) {
+                using beast::websocket::teardown;
+                teardown(role, s, ec);
+            },
+            stream.stream_);
+    }
+
+    template <typename TeardownHandler>
+    friend void async_teardown(
+        beast::role_type role,
+        client_stream_t& stream,
+        TeardownHandler&& handler)
+    {
+        std::visit(
+            [&](auto& s) {
+                using beast::websocket::async_teardown;
+                async_teardown(
+                    role, s, std::forward<TeardownHandler>(handler));
+            },
+            stream.stream_);
+    }
+
+private:
+    std::variant<plain_stream_t, tls_stream_t> stream_;
+};
+
+} // sd
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -13,6 +14,15 @@ namespace net = boost::asio; // NOLINT
 namespace http = beast::http; // NOLINT
 namespace websocket = beast::websocket; // NOLINT
 using tcp = net::ip::tcp;
+using local_stream = net::local::stream_protocol;
+// sessions are served over TCP, or over a local socket behind a router
+using stream_socket_t = net::generic::stream_protocol::socket;
+using plain_stream_t = beast::basic_stream<net::generic::stream_protocol>;
+// players connect in plain text or over TLS, see client_stream.h
+class client_stream_t;
+using websocket_stream_t = websocket::stream<client_stream_t>;
+// the relay is always behind the reverse-proxy
+using plain_websocket_t = websocket::stream<plain_stream_t>;
 
 template <typename T>
 struct use_awaitable_executor {
@@ -26,8 +36,14 @@ class session_t;
 class listener_t;
 class world_t;
 class player_t;
+class player_handle_t;
+class shm_exporter_t;
+
+constexpr std::size_t player_name_max_length = 30;
 
 using player_id_t = boost::uuids::uuid;
-using player_handle_t = std::unique_ptr<player_t, std::function<void(player_t*)>>;
+
+// encoded message, shared by all its recipients
+using frame_t = std::shared_ptr<const std::string>;
 
 } // sd
@@ -0,0 +1,357 @@
+#include "event_log.h"
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <boost/uuid/uuid_io.hpp>
+#include <spdlog/spdlog.h>
+
+namespace sd {
+
+namespace {
+
+constexpr auto consumer_idle_sleep = std::chrono::milliseconds{10};
+constexpr auto dropped_report_period = std::chrono::seconds{10};
+
+class event_log_t {
+public:
+    explicit event_log_t(const event_log_config_t& config)
+        : config_{config}, queue_{config.queue_size}
+    {
+        thread_ = std::thread{[this]() { consume(); }};
+    }
+
+    ~event_log_t()
+    {
+        running_.store(false, std::memory_order_release);
+        thread_.join();
+    }
+
+    event_log_t(const event_log_t&) = delete;
+    event_log_t(event_log_t&&) = delete;
+    event_log_t& operator=(const event_log_t&) = delete;
+    event_log_t& operator=(event_log_t&&) = delete;
+
+    [[nodiscard]] const auto& config() const { return config_; }
+
+    void push(const event_t& event)
+    {
+        if (queue_.try_push(event)) {
+            return;
+        }
+        if (config_.overflow_policy == overflow_policy_t::drop) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // the consumer may be sleeping, the ring only drains once it
+        // is awake
+        {
+            const std::lock_guard lock{wakeup_mutex_};
+            wakeup_requested_ = true;
+        }
+        wakeup_.notify_one();
+        while (!queue_.try_push(event)) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    void consume()
+    {
+        auto last_report = std::chrono::steady_clock::now();
+        event_t event{};
+        while (true) {
+            bool popped = false;
+            while (queue_.try_pop(event)) {
+                format(event);
+                popped = true;
+            }
+
+            if (auto now = std::chrono::steady_clock::now();
+                now - last_report > dropped_report_period) {
+                report_dropped();
+                last_report = now;
+            }
+
+            if (!running_.load(std::memory_order_acquire)) {
+                // drain what was pushed before stopping
+                while (queue_.try_pop(event)) {
+                    format(event);
+                }
+                report_dropped();
+                return;
+            }
+            if (!popped) {
+                std::unique_lock lock{wakeup_mutex_};
+                wakeup_.wait_for(lock, consumer_idle_sleep, [this]() {
+                    return wakeup_requested_;
+                });
+                wakeup_requested_ = false;
+            }
+        }
+    }
+
+    void report_dropped()
+    {
+        if (auto dropped = dropped_.exchange(0, std::memory_order_relaxed)) {
+            spdlog::warn("event log overflow, dropped {} events", dropped);
+        }
+    }
+
+    static void format(const event_t& e)
+    {
+        const auto name = std::string_view{e.name.data(), e.name_size};
+        const auto log = [&]<typename... Args>(
+                             spdlog::level::level_enum level,
+                             spdlog::format_string_t<Args...> fmt,
+                             Args&&... args) {
+            auto* logger = spdlog::default_logger_raw();
+            if (!logger->should_log(level)) {
+                return;
+            }
+            // keep the time at which the event happened,
+            // not the time at which it is formatted
+            spdlog::memory_buf_t buffer;
+            fmt::format_to(
+                std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+            logger->log(
+                e.time,
+                spdlog::source_loc{},
+                level,
+                {buffer.data(), buffer.size()});
+        };
+        const auto log_latency = [&](std::string_view what,
+                                     const event_t& stats) {
+            log(spdlog::level::info,
+                "{} over {} samples: p50 {}us, p99 {}us, max {}us",
+                what,
+                stats.values[0],
+                stats.values[1],
+                stats.values[2],
+                stats.values[3]);
+        };
+
+        switch (e.kind) {
+        case event_kind_t::player_registered:
+            log(spdlog::level::info,
+                "registering player {} ({})",
+                name,
+                to_string(e.player_id));
+            break;
+        case event_kind_t::player_restored:
+            log(spdlog::level::info,
+                "restoring player {} ({})",
+                name,
+                to_string(e.player_id));
+            break;
+        case event_kind_t::player_idle:
+            log(spdlog::level::info,
+                "moving player {} to idle ({})",
+                name,
+                to_string(e.player_id));
+            break;
+        case event_kind_t::player_unregistered:
+            log(spdlog::level::info,
+                "unregistering player {} ({})",
+                name,
+                to_string(e.player_id));
+            break;
+        case event_kind_t::player_unknown:
+            log(spdlog::level::warn,
+                "unregistering unknown player {} ({})",
+                name,
+                to_string(e.player_id));
+            break;
+        case event_kind_t::registration_failed:
+            log(spdlog::level::warn, "client failed to register");
+            break;
+        case event_kind_t::fake_players_added:
+            log(spdlog::level::debug, "adding {} fake players", e.values[0]);
+            break;
+        case event_kind_t::fake_players_removed:
+            log(spdlog::level::debug, "removing {} fake players", e.values[0]);
+            break;
+        case event_kind_t::fake_players_cleared:
+            log(spdlog::level::info,
+                "no more active players, removing all fake players");
+            break;
+        case event_kind_t::tick_stats:
+            log(spdlog::level::info,
+                "tick latency over {} ticks: avg {}us, max {}us",
+                e.values[0],
+                e.values[1] / 1000, // NOLINT(*-magic-numbers)
+                e.values[2] / 1000); // NOLINT(*-magic-numbers)
+            break;
+        case event_kind_t::input_stats:
+            log(spdlog::level::info,
+                "inputs: {} received, {} applied, {} stale",
+                e.values[0],
+                e.values[1],
+                e.values[0] - e.values[1]);
+            break;
+        case event_kind_t::connections_shed:
+            log(spdlog::level::warn,
+                "connections shed: {} rate limited, {} waiting room full",
+                e.values[0],
+                e.values[1]);
+            break;
+        case event_kind_t::ping_rtt_stats:
+            log_latency("ping rtt", e);
+            break;
+        case event_kind_t::input_latency_stats:
+            log_latency("input to broadcast", e);
+            break;
+        case event_kind_t::ack_latency_stats:
+            log_latency("broadcast to ack", e);
+            break;
+        case event_kind_t::tick_load_stats:
+            log(spdlog::level::info,
+                "tick load of {} worlds: avg {:.1f}%, max {:.1f}%, {} late "
+                "batches",
+                e.values[0],
+                static_cast<double>(e.values[1]) / 10, // NOLINT(*-magic-numbers)
+                static_cast<double>(e.values[2]) / 10, // NOLINT(*-magic-numbers)
+                e.values[3]);
+            break;
+        }
+    }
+
+    const event_log_config_t config_;
+    ring_buffer_t<event_t> queue_;
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<bool> running_{true};
+    // wakes the idle consumer up when a blocked producer waits for room
+    std::mutex wakeup_mutex_;
+    std::condition_variable wakeup_;
+    bool wakeup_requested_{false};
+    std::thread thread_;
+};
+
+std::unique_ptr<event_log_t> event_log;
+
+void push_event(const event_t& event)
+{
+    if (event_log) {
+        event_log->push(event);
+    }
+}
+
+}
+
+void start_event_log(const event_log_config_t& config)
+{
+    event_log = std::make_unique<event_log_t>(config);
+}
+
+void stop_event_log()
+{
+    event_log.reset();
+}
+
+void log_player_event(
+    event_kind_t kind,
+    const player_id_t& player_id,
+    std::string_view player_name)
+{
+    if (!event_log || !event_log->config().player_events) {
+        return;
+    }
+
+    event_t event{};
+    event.kind = kind;
+    event.time = event_t::clock_t::now();
+    event.player_id = player_id;
+    event.name_size = static_cast<std::uint8_t>(
+        std::min(player_name.size(), event.name.size()));
+    std::copy_n(player_name.data(), event.name_size, event.name.data());
+    push_event(event);
+}
+
+void log_count_event(event_kind_t kind, std::int64_t count)
+{
+    if (!event_log || !event_log->config().player_events) {
+        return;
+    }
+
+    event_t event{};
+    event.kind = kind;
+    event.time = event_t::clock_t::now();
+    event.values[0] = count;
+    push_event(event);
+}
+
+void log_tick_stats(
+    std::int64_t ticks,
+    std::chrono::nanoseconds average,
+    std::chrono::nanoseconds max)
+{
+    event_t event{};
+    event.kind = event_kind_t::tick_stats;
+    event.time = event_t::clock_t::now();
+    event.values = {ticks, average.count(), max.count()};
+    push_event(event);
+}
+
+void log_tick_load_stats(
+    std::int64_t worlds,
+    double average_load,
+    double max_load,
+    std::int64_t late_batches)
+{
+    constexpr double permille = 1000;
+    event_t event{};
+    event.kind = event_kind_t::tick_load_stats;
+    event.time = event_t::clock_t::now();
+    event.values = {
+        worlds,
+        std::llround(average_load * permille),
+        std::llround(max_load * permille),
+        late_batches,
+    };
+    push_event(event);
+}
+
+void log_input_stats(std::int64_t received, std::int64_t applied)
+{
+    event_t event{};
+    event.kind = event_kind_t::input_stats;
+    event.time = event_t::clock_t::now();
+    event.values[0] = received;
+    event.values[1] = applied;
+    push_event(event);
+}
+
+void log_shed_connections(std::int64_t rate_limited, std::int64_t queue_full)
+{
+    event_t event{};
+    event.kind = event_kind_t::connections_shed;
+    event.time = event_t::clock_t::now();
+    event.values[0] = rate_limited;
+    event.values[1] = queue_full;
+    push_event(event);
+}
+
+void log_latency_stats(event_kind_t kind, const latency_histogram_t& histogram)
+{
+    if (histogram.count() == 0) {
+        return;
+    }
+    event_t event{};
+    event.kind = kind;
+    event.time = event_t::clock_t::now();
+    event.values = {
+        histogram.count(),
+        histogram.percentile(0.5).count(), // NOLINT(*-magic-numbers)
+        histogram.percentile(0.99).count(), // NOLINT(*-magic-numbers)
+        histogram.max().count(),
+    };
+    push_event(event);
+}
+
+} // sd
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include "config.h"
+#include "latency_histogram.h"
+
+namespace sd {
+
+// Gameplay events are recorded as fixed-size binary records
+// into a lock-free ring buffer and formatted later, on a
+// dedicated thread, so that the simulation never formats
+// strings nor touches the log sinks.
+enum class event_kind_t : std::uint8_t {
+    player_registered,
+    player_restored,
+    player_idle,
+    player_unregistered,
+    player_unknown,
+    registration_failed,
+    fake_players_added,
+    fake_players_removed,
+    fake_players_cleared,
+    tick_stats,
+    input_stats,
+    connections_shed,
+    ping_rtt_stats,
+    input_latency_stats,
+    ack_latency_stats,
+    tick_load_stats,
+};
+
+struct event_t {
+    using clock_t = std::chrono::system_clock;
+
+    event_kind_t kind;
+    clock_t::time_point time;
+    player_id_t player_id;
+    std::uint8_t name_size;
+    std::array<char, player_name_max_length> name;
+    std::array<std::int64_t, 4> values;
+};
+
+enum class overflow_policy_t {
+    // drop the event and count it, the producer never waits
+    drop,
+    // wait for the logging thread to make room, it is woken up right
+    // away but the producer still waits for events to be formatted
+    block,
+};
+
+struct event_log_config_t {
+    std::size_t queue_size{4096}; // NOLINT(*-magic-numbers)
+    overflow_policy_t overflow_policy{overflow_policy_t::drop};
+    // player related events can be disabled, stats are always logged
+    bool player_events{true};
+};
+
+void start_event_log(const event_log_config_t& config);
+void stop_event_log();
+
+void log_player_event(
+    event_kind_t kind,
+    const player_id_t& player_id,
+    std::string_view player_name);
+void log_count_event(event_kind_t kind, std::int64_t count);
+void log_tick_stats(
+    std::int64_t ticks,
+    std::chrono::nanoseconds average,
+    std::chrono::nanoseconds max);
+// loads are fractions of the tick period
+void log_tick_load_stats(
+    std::int64_t worlds,
+    double average_load,
+    double max_load,
+    std::int64_t late_batches);
+void log_input_stats(std::int64_t received, std::int64_t applied);
+void log_shed_connections(std::int64_t rate_limited, std::int64_t queue_full);
+// one of the *_latency_stats or ping_rtt_stats kinds
+void log_latency_stats(
+    event_kind_t kind,
+    const latency_histogram_t& histogram);
+
+} // sd
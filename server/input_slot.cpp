@@ -0,0 +1,53 @@
+#include "input_slot.h"
+
+namespace sd {
+
+void input_slot_t::write_dd(double ddx, double ddy)
+{
+    const auto seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ddx_.store(ddx, std::memory_order_relaxed);
+    ddy_.store(ddy, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+}
+
+void input_slot_t::request_respawn()
+{
+    respawn_.store(true, std::memory_order_release);
+}
+
+bool input_slot_t::consume(input_t& input)
+{
+    input.respawn = respawn_.exchange(false, std::memory_order_acquire);
+    input.has_dd = false;
+    input.received = 0;
+
+    while (true) {
+        const auto seq = seq_.load(std::memory_order_acquire);
+        if (seq == consumed_seq_) {
+            return input.respawn;
+        }
+        if (seq % 2 != 0) {
+            // the writer is in the middle of an update, it's only
+            // storing two doubles so it will be done in a few cycles
+            continue;
+        }
+
+        input.ddx = ddx_.load(std::memory_order_relaxed);
+        input.ddy = ddy_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+
+        // counted from the sequence number committed, the inputs written
+        // after it are counted by the next call
+        input.received = (seq - consumed_seq_) / 2;
+        consumed_seq_ = seq;
+        input.has_dd = true;
+        return true;
+    }
+}
+
+} // sd
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace sd {
+
+// Latest input of a player. There is a single writer (the session
+// receiving the inputs) and a single reader (the world, at the start
+// of each tick). Inputs written between two ticks overwrite each other,
+// only the last one is applied.
+class input_slot_t {
+public:
+    struct input_t {
+        bool has_dd;
+        double ddx, ddy;
+        bool respawn;
+        // dd inputs written since the previous call, the last one applied
+        std::uint64_t received;
+    };
+
+    // writer side
+    void write_dd(double ddx, double ddy);
+    void request_respawn();
+
+    // reader side, returns false if nothing was written since the last call
+    bool consume(input_t& input);
+
+private:
+    // seqlock, odd while the writer is updating the values
+    std::atomic<std::uint64_t> seq_{0};
+    std::atomic<double> ddx_{0};
+    std::atomic<double> ddy_{0};
+    std::atomic<bool> respawn_{false};
+
+    // only accessed by the reader
+    std::uint64_t consumed_seq_{0};
+};
+
+} // sd
@@ -0,0 +1,63 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sd {
+
+namespace {
+
+// 0 for 0us, then i for [2^(i-1), 2^i)us
+std::size_t bucket_of(std::uint64_t us)
+{
+    std::size_t bucket = 0;
+    while (us != 0) {
+        us >>= 1U;
+        ++bucket;
+    }
+    return bucket;
+}
+
+}
+
+void latency_histogram_t::record(std::chrono::nanoseconds latency)
+{
+    const auto us = std::max<std::int64_t>(
+        std::chrono::duration_cast<duration_t>(latency).count(), 0);
+    const auto bucket =
+        std::min(bucket_of(static_cast<std::uint64_t>(us)), buckets - 1);
+    ++counts_[bucket];
+    ++count_;
+    max_ = std::max(max_, duration_t{us});
+}
+
+void latency_histogram_t::reset()
+{
+    counts_.fill(0);
+    count_ = 0;
+    max_ = {};
+}
+
+latency_histogram_t::duration_t latency_histogram_t::percentile(double p) const
+{
+    const auto rank = static_cast<std::int64_t>(
+        std::ceil(p * static_cast<double>(count_)));
+    std::int64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < buckets; ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= rank && seen > 0) {
+            const duration_t upper_bound{std::int64_t{1} << bucket};
+            return std::min(upper_bound, max_);
+        }
+    }
+    return max_;
+}
+
+void latency_stats_t::reset()
+{
+    ping_rtt.reset();
+    input_to_broadcast.reset();
+    broadcast_to_ack.reset();
+}
+
+} // sd
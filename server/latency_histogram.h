@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace sd {
+
+// Latencies counted in power of two buckets of microseconds. Recording
+// is an increment, percentiles are the upper bound of their bucket.
+class latency_histogram_t {
+public:
+    using duration_t = std::chrono::microseconds;
+
+    void record(std::chrono::nanoseconds latency);
+    void reset();
+
+    [[nodiscard]] std::int64_t count() const { return count_; }
+    [[nodiscard]] duration_t max() const { return max_; }
+    // p in [0, 1]
+    [[nodiscard]] duration_t percentile(double p) const;
+
+private:
+    // the last one gathers everything above 2^30us, about 18 minutes
+    static constexpr std::size_t buckets = 32;
+
+    std::array<std::int64_t, buckets> counts_{};
+    std::int64_t count_{0};
+    duration_t max_{0};
+};
+
+// Measured by the sessions of a world, reported with the tick stats
+struct latency_stats_t {
+    // websocket ping to pong
+    latency_histogram_t ping_rtt;
+    // input received to the first state sent after it was applied
+    latency_histogram_t input_to_broadcast;
+    // state sent to the input acknowledging it was displayed
+    latency_histogram_t broadcast_to_ack;
+
+    void reset();
+};
+
+} // sd
@@ -1,14 +1,58 @@
 #include "listener.h"
+#include "client_stream.h"
+#include "event_log.h"
+#include "router.h"
 #include "session.h"
+#include "waiting_room.h"
 #include "world.h"
 
+#include <unistd.h>
+
 namespace sd {
 
+namespace {
+
+constexpr auto shed_report_period = std::chrono::seconds{10};
+
+}
+
 listener_t::listener_t(
     net::io_context& ioc,
     std::vector<std::shared_ptr<world_t>> worlds,
-    const tcp::endpoint& endpoint)
-    : ioc_{ioc}, acceptor_{ioc}, worlds_{std::move(worlds)}
+    const tcp::endpoint& endpoint,
+    const listener_config_t& config)
+    : ioc_{ioc},
+      acceptor_{ioc},
+      worlds_{std::move(worlds)},
+      waiting_room_{
+          std::make_shared<waiting_room_t>(worlds_, config.max_waiting)},
+      tls_{config.tls},
+      rate_limiter_{config.accept_rate, config.accept_burst}
+{
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(net::socket_base::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen(net::socket_base::max_listen_connections);
+
+    for (auto& world_ptr : worlds_) {
+        world_ptr->on_places_available(
+            [waiting_room = std::weak_ptr{waiting_room_}]() {
+                if (auto room = waiting_room.lock()) {
+                    room->admit();
+                }
+            });
+    }
+}
+
+listener_t::listener_t(
+    net::io_context& ioc,
+    std::shared_ptr<router_t> router,
+    const tcp::endpoint& endpoint,
+    const listener_config_t& config)
+    : ioc_{ioc},
+      acceptor_{ioc},
+      router_{std::move(router)},
+      rate_limiter_{config.accept_rate, config.accept_burst}
 {
     acceptor_.open(endpoint.protocol());
     acceptor_.set_option(net::socket_base::reuse_address(true));
@@ -26,24 +70,131 @@ void listener_t::run()
         net::detached);
 }
 
+void listener_t::serve_forwarded(const std::string& path)
+{
+    // remove the socket left by a previous run
+    ::unlink(path.c_str());
+
+    const local_stream::endpoint endpoint{path};
+    local_stream::acceptor acceptor{ioc_};
+    acceptor.open(endpoint.protocol());
+    acceptor.bind(endpoint);
+    acceptor.listen(net::socket_base::max_listen_connections);
+
+    net::co_spawn(
+        ioc_,
+        [self = shared_from_this(),
+         acceptor = std::move(acceptor)]() mutable -> net::awaitable<void> {
+            co_await self->on_serve_forwarded(std::move(acceptor));
+        },
+        net::detached);
+}
+
 net::awaitable<void> listener_t::on_run()
 {
-    spdlog::info(
-        "listening on {}:{}, generated {} worlds",
-        acceptor_.local_endpoint().address().to_string(),
-        acceptor_.local_endpoint().port(),
-        worlds_.size());
+    if (router_) {
+        spdlog::info(
+            "routing connections from {}:{}",
+            acceptor_.local_endpoint().address().to_string(),
+            acceptor_.local_endpoint().port());
+    }
+    else {
+        spdlog::info(
+            "listening on {}:{} ({}), generated {} worlds",
+            acceptor_.local_endpoint().address().to_string(),
+            acceptor_.local_endpoint().port(),
+            tls_ ? "wss" : "ws",
+            worlds_.size());
+    }
 
     while (true) {
         auto socket = co_await acceptor_.async_accept(net::use_awaitable);
-        for (auto& world_ptr : worlds_) {
-            if (world_ptr->available_places() == 0) {
-                continue;
-            }
 
-            std::make_shared<session_t>(world_ptr, std::move(socket))->run();
-            break;
+        // shed excess load as early and cheaply as possible,
+        // before spending anything on the handshake
+        boost::system::error_code ec;
+        const auto remote = socket.remote_endpoint(ec);
+        if (ec
+            || !rate_limiter_.allow(
+                remote.address(), std::chrono::steady_clock::now())) {
+            stream_socket_t shed_socket{std::move(socket)};
+            shed(shed_socket, rate_limited_);
+            continue;
         }
+        // small messages, the states and the handshake flights,
+        // are sent right away instead of waiting for acks
+        socket.set_option(tcp::no_delay{true}, ec);
+
+        if (router_) {
+            router_->route(std::move(socket));
+            continue;
+        }
+        dispatch(std::move(socket));
+    }
+}
+
+net::awaitable<void> listener_t::on_serve_forwarded(
+    local_stream::acceptor acceptor)
+{
+    spdlog::info(
+        "serving forwarded connections on {}",
+        acceptor.local_endpoint().path());
+
+    while (true) {
+        // the router already applied the rate limit
+        dispatch(co_await acceptor.async_accept(net::use_awaitable));
+    }
+}
+
+void listener_t::dispatch(stream_socket_t&& socket)
+{
+    if (auto world_ptr = find_available_world()) {
+        std::make_shared<session_t>(
+            world_ptr, client_stream(std::move(socket)), waiting_room_)
+            ->run();
+        return;
+    }
+
+    if (waiting_room_->full()) {
+        shed(socket, waiting_room_full_);
+        return;
+    }
+    waiting_room_->enter(client_stream(std::move(socket)));
+}
+
+client_stream_t listener_t::client_stream(stream_socket_t&& socket) const
+{
+    // the TLS handshake is done with the websocket one, by the session
+    // or the waiting room
+    if (tls_) {
+        return client_stream_t{std::move(socket), *tls_};
+    }
+    return client_stream_t{std::move(socket)};
+}
+
+std::shared_ptr<world_t> listener_t::find_available_world() const
+{
+    for (const auto& world_ptr : worlds_) {
+        if (world_ptr->available_places() > 0) {
+            return world_ptr;
+        }
+    }
+    return {};
+}
+
+void listener_t::shed(stream_socket_t& socket, std::uint64_t& counter)
+{
+    boost::system::error_code ec;
+    socket.close(ec);
+    ++counter;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_shed_report_ > shed_report_period) {
+        log_shed_connections(
+            static_cast<std::int64_t>(rate_limited_),
+            static_cast<std::int64_t>(waiting_room_full_));
+        rate_limited_ = waiting_room_full_ = 0;
+        last_shed_report_ = now;
     }
 }
 
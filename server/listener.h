@@ -4,28 +4,69 @@
 #include <string>
 
 #include <boost/asio.hpp>
+#include <boost/asio/ssl/context.hpp>
 #include <boost/beast.hpp>
 #include <spdlog/spdlog.h>
 
 #include "config.h"
+#include "rate_limiter.h"
 
 namespace sd {
 
+class router_t;
+class waiting_room_t;
+
+struct listener_config_t {
+    // clients waiting for a place, further connections are dropped
+    std::size_t max_waiting{256}; // NOLINT(*-magic-numbers)
+    // accepted connections per second for a single address, 0 disables it
+    double accept_rate{0};
+    double accept_burst{10}; // NOLINT(*-magic-numbers)
+    // serves wss:// instead of ws:// when set, see tls_context.h
+    std::shared_ptr<net::ssl::context> tls;
+};
+
 class listener_t : public std::enable_shared_from_this<listener_t> {
 public:
     listener_t(
         net::io_context& ioc,
         std::vector<std::shared_ptr<world_t>> worlds,
-        const tcp::endpoint& endpoint);
+        const tcp::endpoint& endpoint,
+        const listener_config_t& config = {});
+    // router mode: connections are forwarded to backend processes
+    listener_t(
+        net::io_context& ioc,
+        std::shared_ptr<router_t> router,
+        const tcp::endpoint& endpoint,
+        const listener_config_t& config = {});
 
     void run();
+    // also serve the connections forwarded by a router on a local socket
+    void serve_forwarded(const std::string& path);
+
+    [[nodiscard]] tcp::endpoint local_endpoint() const
+    {
+        return acceptor_.local_endpoint();
+    }
 
 private:
     net::awaitable<void> on_run();
+    net::awaitable<void> on_serve_forwarded(local_stream::acceptor acceptor);
+    void dispatch(stream_socket_t&& socket);
+    client_stream_t client_stream(stream_socket_t&& socket) const;
+    std::shared_ptr<world_t> find_available_world() const;
+    void shed(stream_socket_t& socket, std::uint64_t& counter);
 
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     std::vector<std::shared_ptr<world_t>> worlds_;
+    std::shared_ptr<router_t> router_;
+    std::shared_ptr<waiting_room_t> waiting_room_;
+    std::shared_ptr<net::ssl::context> tls_;
+    rate_limiter_t rate_limiter_;
+    std::uint64_t rate_limited_{0};
+    std::uint64_t waiting_room_full_{0};
+    std::chrono::steady_clock::time_point last_shed_report_;
 };
 
 } // sd
@@ -1,7 +1,14 @@
 #include <iostream>
+#include <string_view>
 #include <spdlog/spdlog.h>
 
+#include "event_log.h"
 #include "listener.h"
+#include "router.h"
+#include "shm_exporter.h"
+#include "spectator.h"
+#include "tls_context.h"
+#include "trace.h"
 #include "world.h"
 
 using namespace sd;
@@ -9,6 +16,86 @@ using namespace sd;
 constexpr auto addr_envvar = "ADDR";
 constexpr auto port_envvar = "PORT";
 constexpr auto nworlds_envvar = "NWORLDS";
+constexpr auto log_queue_size_envvar = "LOG_QUEUE_SIZE";
+constexpr auto log_overflow_envvar = "LOG_OVERFLOW";
+constexpr auto log_events_envvar = "LOG_EVENTS";
+constexpr auto trace_file_envvar = "TRACE_FILE";
+constexpr auto max_waiting_envvar = "MAX_WAITING";
+constexpr auto accept_rate_envvar = "ACCEPT_RATE";
+constexpr auto accept_burst_envvar = "ACCEPT_BURST";
+constexpr auto spectator_socket_envvar = "SPECTATOR_SOCKET";
+constexpr auto router_socket_envvar = "ROUTER_SOCKET";
+constexpr auto backend_socket_envvar = "BACKEND_SOCKET";
+constexpr auto shm_export_envvar = "SHM_EXPORT";
+constexpr auto tls_cert_envvar = "TLS_CERT";
+constexpr auto tls_key_envvar = "TLS_KEY";
+constexpr auto tls_resumption_envvar = "TLS_RESUMPTION";
+
+event_log_config_t event_log_config_from_env()
+{
+    event_log_config_t config;
+    if (const auto* queue_size = std::getenv(log_queue_size_envvar)) {
+        config.queue_size = static_cast<std::size_t>(std::atol(queue_size));
+    }
+    if (const auto* overflow = std::getenv(log_overflow_envvar)) {
+        config.overflow_policy = std::string_view{overflow} == "block"
+                                     ? overflow_policy_t::block
+                                     : overflow_policy_t::drop;
+    }
+    if (const auto* events = std::getenv(log_events_envvar)) {
+        config.player_events = std::string_view{events} != "off";
+    }
+    return config;
+}
+
+listener_config_t listener_config_from_env()
+{
+    listener_config_t config;
+    if (const auto* max_waiting = std::getenv(max_waiting_envvar)) {
+        config.max_waiting = static_cast<std::size_t>(std::atol(max_waiting));
+    }
+    if (const auto* accept_rate = std::getenv(accept_rate_envvar)) {
+        config.accept_rate = std::atof(accept_rate);
+    }
+    if (const auto* accept_burst = std::getenv(accept_burst_envvar)) {
+        config.accept_burst = std::atof(accept_burst);
+    }
+    return config;
+}
+
+// nullptr without a certificate, throws boost::system::system_error
+std::shared_ptr<net::ssl::context> tls_context_from_env()
+{
+    const auto* cert = std::getenv(tls_cert_envvar);
+    if (cert == nullptr) {
+        return {};
+    }
+    const auto* key = std::getenv(tls_key_envvar);
+    tls_config_t config{cert, key ? key : cert};
+    if (const auto* resumption = std::getenv(tls_resumption_envvar)) {
+        config.resumption = std::string_view{resumption} != "off";
+    }
+    return make_tls_context(config);
+}
+
+void dump_trace_on_signal(net::signal_set& signals)
+{
+    signals.async_wait([&signals](const beast::error_code& ec, int) {
+        if (ec) {
+            return;
+        }
+
+        const auto* mb_path = std::getenv(trace_file_envvar);
+        const std::string path = mb_path ? mb_path : "trace.json";
+        if (dump_trace(path)) {
+            spdlog::info("trace written to {}", path);
+        }
+        else {
+            spdlog::error("failed to write trace to {}", path);
+        }
+        dump_trace_on_signal(signals);
+    });
+}
 
 int main(int /*argc*/, char* /*argv*/[])
 {
@@ -19,38 +106,124 @@ int main(int /*argc*/, char* /*argv*/[])
         return EXIT_FAILURE;
     }
     const auto* mb_port = std::getenv(port_envvar);
-    if (mb_address == nullptr) {
+    if (mb_port == nullptr) {
         std::cerr << "Environment variable " << port_envvar << " is not defined"
                   << std::endl;
         return EXIT_FAILURE;
     }
+
+    // With a router socket but no backend socket, this process is
+    // the router and holds no world. With both, it is a backend.
+    const auto* mb_router_path = std::getenv(router_socket_envvar);
+    const auto* mb_backend_path = std::getenv(backend_socket_envvar);
+    const bool is_router = mb_router_path != nullptr && mb_backend_path == nullptr;
+
     const auto* mb_nworlds = std::getenv(nworlds_envvar);
-    if (mb_address == nullptr) {
+    if (mb_nworlds == nullptr && !is_router) {
         std::cerr << "Environment variable " << nworlds_envvar
                   << " is not defined" << std::endl;
         return EXIT_FAILURE;
     }
 
+    auto listener_config = listener_config_from_env();
+    try {
+        listener_config.tls = tls_context_from_env();
+    }
+    catch (const boost::system::system_error& exc) {
+        std::cerr << "Can't load the TLS certificate: " << exc.what()
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (listener_config.tls && mb_router_path != nullptr) {
+        // the router reads the upgrade requests to route them
+        std::cerr << "TLS is not supported with a router" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     const auto address = net::ip::make_address(mb_address);
     const auto port = static_cast<unsigned short>(std::atoi(mb_port));
-    const auto nworlds = std::atoi(mb_nworlds);
+
+    start_event_log(event_log_config_from_env());
 
     // The io_context is required for all I/O
     net::io_context ioc{1};
+    // outlives the ticks of the worlds, which stop with ioc.run()
+    std::unique_ptr<shm_exporter_t> exporter;
 
-    std::vector<std::shared_ptr<world_t>> worlds;
-    for (int i = 0; i < nworlds; ++i) {
-        worlds.emplace_back(std::make_shared<world_t>(ioc));
-        worlds.back()->run();
+    if (is_router) {
+        auto router = std::make_shared<router_t>(ioc, mb_router_path);
+        router->run();
+        std::make_shared<listener_t>(
+            ioc,
+            std::move(router),
+            tcp::endpoint{address, port},
+            listener_config)
+            ->run();
+    }
+    else {
+        const auto nworlds = std::atoi(mb_nworlds);
+        std::vector<std::shared_ptr<world_t>> worlds;
+        for (int i = 0; i < nworlds; ++i) {
+            auto world = std::make_shared<world_t>(ioc);
+            try {
+                world->run();
+            }
+            catch (const tick_period_saturated&) {
+                spdlog::warn(
+                    "tick period saturated, running {} worlds out of {}",
+                    i,
+                    nworlds);
+                break;
+            }
+            worlds.push_back(std::move(world));
+        }
+        if (const auto* mb_name = std::getenv(shm_export_envvar)) {
+            try {
+                exporter = std::make_unique<shm_exporter_t>(
+                    mb_name, worlds.size());
+            }
+            catch (const std::system_error& exc) {
+                std::cerr << "Can't export to shared memory " << mb_name
+                          << ": " << exc.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+            for (std::size_t i = 0; i < worlds.size(); ++i) {
+                worlds[i]->export_to(*exporter, i);
+            }
+        }
+        if (const auto* mb_path = std::getenv(spectator_socket_envvar)) {
+            std::make_shared<spectator_listener_t>(ioc, worlds, mb_path)->run();
+        }
+        if (mb_backend_path != nullptr && mb_router_path != nullptr) {
+            std::make_shared<occupancy_reporter_t>(
+                ioc, worlds, mb_router_path, mb_backend_path)
+                ->run();
+        }
+
+        auto listener = std::make_shared<listener_t>(
+            ioc,
+            std::move(worlds),
+            tcp::endpoint{address, port},
+            listener_config);
+        listener->run();
+        if (mb_backend_path != nullptr) {
+            listener->serve_forwarded(mb_backend_path);
+        }
     }
-    std::make_shared<listener_t>(ioc, std::move(worlds), tcp::endpoint{address, port})
-        ->run();
 
     // Capture SIGINT and SIGTERM to perform a clean shutdown
     net::signal_set signals(ioc, SIGINT, SIGTERM);
     signals.async_wait([&](const beast::error_code&, int) { ioc.stop(); });
 
+    // Dump the tracing spans on SIGUSR1
+    net::signal_set trace_signals(ioc);
+    if (tracing_enabled) {
+        trace_signals.add(SIGUSR1);
+        dump_trace_on_signal(trace_signals);
+    }
+
     ioc.run();
+    stop_event_log();
 
     return EXIT_SUCCESS;
 }
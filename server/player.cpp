@@ -1,7 +1,9 @@
 #include "player.h"
+#include "process_stats.h"
 #include "world.h"
 
 #include <algorithm>
+#include <random>
 
 namespace sd {
 namespace {
@@ -10,7 +12,8 @@ constexpr auto score_multiplier = 1000;
 
 player_t::player_t(world_t& world, id_t id, std::string_view name, bool fake)
     : id_{id},
-      name_{name},
+      name_size_{static_cast<std::uint8_t>(
+          std::min(name.size(), player_name_max_length))},
       score_{0},
       best_score_{0},
       fake_{fake},
@@ -19,7 +22,14 @@ player_t::player_t(world_t& world, id_t id, std::string_view name, bool fake)
       world_{world},
       alive_{false}
 {
+    std::copy_n(name.data(), name_size_, name_.data());
     respawn();
+    live_players.fetch_add(1, std::memory_order_relaxed);
+}
+
+player_t::~player_t()
+{
+    live_players.fetch_sub(1, std::memory_order_relaxed);
 }
 
 bool player_t::operator==(const player_t& other) const
@@ -56,8 +66,10 @@ void player_t::respawn()
     std::uniform_real_distribution<> rnd(low_bound, high_bound);
 
     state_.dx = state_.dy = state_.ddx = state_.ddy = 0;
-    state_.x = rnd(rnd_gen_);
-    state_.y = rnd(rnd_gen_);
+    // the generator is shared by the players of the world
+    auto& rnd_gen = world_.random_generator();
+    state_.x = rnd(rnd_gen);
+    state_.y = rnd(rnd_gen);
     alive_ = true;
     score_ = 0;
 }
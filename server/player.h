@@ -1,13 +1,11 @@
 #pragma once
 
-#include <list>
-#include <memory>
-#include <random>
-#include <string>
+#include <array>
 #include <string_view>
 #include <spdlog/spdlog.h>
 
 #include "config.h"
+#include "input_slot.h"
 
 namespace sd {
 
@@ -23,7 +21,7 @@ public:
     static constexpr double max_dd = 5;
 
     player_t(world_t& world, id_t id, std::string_view name, bool fake);
-    ~player_t() = default;
+    ~player_t();
 
     player_t(const player_t&) = delete;
     player_t(player_t&&) = delete;
@@ -41,8 +39,12 @@ public:
     void update_pos(std::chrono::nanoseconds dt);
 
     [[nodiscard]] const auto& state() const { return state_; };
+    [[nodiscard]] input_slot_t& input() { return input_; }
     [[nodiscard]] id_t id() const { return id_; }
-    [[nodiscard]] const std::string& name() const { return name_; }
+    [[nodiscard]] std::string_view name() const
+    {
+        return {name_.data(), name_size_};
+    }
     [[nodiscard]] bool alive() const { return alive_; }
     [[nodiscard]] bool fake() const { return fake_; }
     [[nodiscard]] double score() const { return score_; }
@@ -57,15 +59,17 @@ public:
 private:
     world_t& world_;
 
-    std::mt19937 rnd_gen_{std::random_device{}()};
     const id_t id_;
-    const std::string name_;
+    // stored inline, longer names are truncated
+    std::uint8_t name_size_;
+    std::array<char, player_name_max_length> name_;
     double score_;
     double best_score_;
     bool fake_;
     state_t state_;
     double acc_;
     bool alive_;
+    input_slot_t input_;
 };
 
 } // sd
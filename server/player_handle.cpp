@@ -0,0 +1,51 @@
+#include "player_handle.h"
+#include "world.h"
+
+#include <utility>
+
+namespace sd {
+
+player_handle_t::player_handle_t(
+    world_t& world,
+    std::uint32_t index,
+    std::uint32_t generation)
+    : world_{&world}, index_{index}, generation_{generation}
+{
+}
+
+player_handle_t::~player_handle_t()
+{
+    reset();
+}
+
+player_handle_t::player_handle_t(player_handle_t&& other) noexcept
+    : world_{std::exchange(other.world_, nullptr)},
+      index_{other.index_},
+      generation_{other.generation_}
+{
+}
+
+player_handle_t& player_handle_t::operator=(player_handle_t&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        world_ = std::exchange(other.world_, nullptr);
+        index_ = other.index_;
+        generation_ = other.generation_;
+    }
+    return *this;
+}
+
+player_t* player_handle_t::get() const
+{
+    return world_ ? world_->find_player(index_, generation_) : nullptr;
+}
+
+void player_handle_t::reset()
+{
+    if (auto* world = std::exchange(world_, nullptr)) {
+        world->unregister_player(index_, generation_);
+    }
+}
+
+} // sd
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include "config.h"
+
+namespace sd {
+
+// Reference to a player registered in a world: the index of its slot
+// and the generation of the slot at registration. The player is
+// unregistered when the handle is destroyed. The handle does not keep
+// the world alive, its owner must.
+class player_handle_t {
+public:
+    player_handle_t() = default;
+    player_handle_t(world_t& world, std::uint32_t index, std::uint32_t generation);
+    ~player_handle_t();
+
+    player_handle_t(const player_handle_t&) = delete;
+    player_handle_t& operator=(const player_handle_t&) = delete;
+
+    player_handle_t(player_handle_t&& other) noexcept;
+    player_handle_t& operator=(player_handle_t&& other) noexcept;
+
+    // nullptr if the slot was reused since the registration
+    [[nodiscard]] player_t* get() const;
+    player_t* operator->() const { return get(); }
+    player_t& operator*() const { return *get(); }
+    explicit operator bool() const { return world_ != nullptr; }
+
+    void reset();
+
+private:
+    world_t* world_{nullptr};
+    std::uint32_t index_{0};
+    std::uint32_t generation_{0};
+};
+
+} // sd
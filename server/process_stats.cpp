@@ -0,0 +1,61 @@
+#include "process_stats.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include <malloc.h>
+#include <unistd.h>
+
+namespace sd {
+
+std::atomic<std::int64_t> live_sessions{0};
+std::atomic<std::int64_t> live_players{0};
+
+namespace {
+
+std::int64_t rss_bytes()
+{
+    // second field of statm is the resident set size, in pages
+    std::ifstream statm{"/proc/self/statm"};
+    std::int64_t size = 0;
+    std::int64_t resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+std::int64_t heap_bytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return static_cast<std::int64_t>(mallinfo2().uordblks);
+#else
+    // may wrap above 2GB, good enough to spot a trend
+    return static_cast<unsigned int>(mallinfo().uordblks);
+#endif
+}
+
+std::int64_t open_fds()
+{
+    std::error_code ec;
+    std::int64_t count = 0;
+    for (auto it = std::filesystem::directory_iterator{"/proc/self/fd", ec};
+         !ec && it != std::filesystem::directory_iterator{};
+         it.increment(ec)) {
+        ++count;
+    }
+    return count;
+}
+
+}
+
+process_stats_t sample_process_stats()
+{
+    return {
+        .rss_bytes = rss_bytes(),
+        .heap_bytes = heap_bytes(),
+        .open_fds = open_fds(),
+        .sessions = live_sessions.load(std::memory_order_relaxed),
+        .players = live_players.load(std::memory_order_relaxed),
+    };
+}
+
+} // sd
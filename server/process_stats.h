@@ -0,0 +1,23 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace sd {
+
+// Number of live session_t and player_t instances
+extern std::atomic<std::int64_t> live_sessions;
+extern std::atomic<std::int64_t> live_players;
+
+struct process_stats_t {
+    std::int64_t rss_bytes;
+    // bytes currently allocated through malloc
+    std::int64_t heap_bytes;
+    std::int64_t open_fds;
+    std::int64_t sessions;
+    std::int64_t players;
+};
+
+process_stats_t sample_process_stats();
+
+} // sd
@@ -0,0 +1,62 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+
+namespace sd {
+
+namespace {
+
+constexpr std::size_t cleanup_period = 1024;
+
+}
+
+rate_limiter_t::rate_limiter_t(double rate, double burst)
+    : rate_{rate}, burst_{std::max(burst, 1.)}
+{
+}
+
+bool rate_limiter_t::allow(
+    const net::ip::address& address,
+    clock_t::time_point now)
+{
+    if (rate_ <= 0) {
+        return true;
+    }
+
+    if (++calls_since_cleanup_ >= cleanup_period) {
+        cleanup(now);
+    }
+
+    auto [it, inserted] = buckets_.try_emplace(address, bucket_t{burst_, now});
+    auto& bucket = it->second;
+    if (!inserted) {
+        const auto elapsed =
+            std::chrono::duration<double>(now - bucket.last).count();
+        bucket.tokens = std::min(burst_, bucket.tokens + elapsed * rate_);
+        bucket.last = now;
+    }
+
+    if (bucket.tokens < 1) {
+        return false;
+    }
+    bucket.tokens -= 1;
+    return true;
+}
+
+void rate_limiter_t::cleanup(clock_t::time_point now)
+{
+    // forget the addresses whose bucket is full again,
+    // so that the map does not grow with every client ever seen
+    const auto refill_time = std::chrono::duration<double>(burst_ / rate_);
+    for (auto it = begin(buckets_); it != end(buckets_);) {
+        if (now - it->second.last >= refill_time) {
+            it = buckets_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    calls_since_cleanup_ = 0;
+}
+
+} // sd
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+
+#include "config.h"
+
+namespace sd {
+
+// Token bucket per source address
+class rate_limiter_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    // rate in tokens per second, 0 disables the limiter
+    rate_limiter_t(double rate, double burst);
+
+    bool allow(const net::ip::address& address, clock_t::time_point now);
+
+private:
+    struct bucket_t {
+        double tokens;
+        clock_t::time_point last;
+    };
+
+    void cleanup(clock_t::time_point now);
+
+    double rate_;
+    double burst_;
+    std::map<net::ip::address, bucket_t> buckets_;
+    std::size_t calls_since_cleanup_{0};
+};
+
+} // sd
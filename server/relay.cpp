@@ -0,0 +1,308 @@
+// Spectator relay: subscribes to the worlds of a server over its
+// spectator socket and rebroadcasts the frames to websocket viewers.
+// Each frame is read once and written to all the viewers of its world
+// from the same buffer, the server cost does not depend on the number
+// of viewers.
+
+#include <charconv>
+#include <iostream>
+#include <map>
+
+#include <spdlog/spdlog.h>
+
+#include "config.h"
+#include "spectator.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto addr_envvar = "ADDR";
+constexpr auto port_envvar = "PORT";
+constexpr auto spectator_socket_envvar = "SPECTATOR_SOCKET";
+
+constexpr auto reconnect_delay = std::chrono::seconds{1};
+constexpr std::size_t max_frame_size = 1 << 20;
+
+// A websocket viewer, only the latest frame is kept
+// while a write is in progress
+class viewer_t : public std::enable_shared_from_this<viewer_t> {
+public:
+    explicit viewer_t(plain_websocket_t&& ws)
+        : ws_{std::move(ws)}, wakeup_{ws_.get_executor()}
+    {
+    }
+
+    void push(const frame_t& frame)
+    {
+        pending_ = frame;
+        wakeup_.cancel();
+    }
+
+    net::awaitable<void> write_loop()
+    {
+        while (!closed_) {
+            if (!pending_) {
+                boost::system::error_code ec;
+                wakeup_.expires_at(net::steady_timer::time_point::max());
+                co_await wakeup_.async_wait(
+                    net::redirect_error(net::use_awaitable, ec));
+                continue;
+            }
+
+            // the frame is shared with the other viewers, not copied
+            const auto frame = std::move(pending_);
+            pending_.reset();
+            co_await ws_.async_write(net::buffer(*frame), net::use_awaitable);
+        }
+    }
+
+    net::awaitable<void> read_loop()
+    {
+        // viewers are read-only, read only to notice the close
+        beast::flat_buffer buffer;
+        while (ws_.is_open()) {
+            co_await ws_.async_read(buffer, net::use_awaitable);
+            buffer.clear();
+        }
+    }
+
+    void close()
+    {
+        closed_ = true;
+        boost::system::error_code ec;
+        beast::get_lowest_layer(ws_).socket().close(ec);
+        wakeup_.cancel();
+    }
+
+private:
+    plain_websocket_t ws_;
+    net::steady_timer wakeup_;
+    frame_t pending_;
+    bool closed_{false};
+};
+
+// Subscription to one world of the server, shared by all its viewers
+class upstream_t : public std::enable_shared_from_this<upstream_t> {
+public:
+    upstream_t(net::io_context& ioc, std::string path, std::size_t world)
+        : ioc_{ioc}, path_{std::move(path)}, world_{world}
+    {
+    }
+
+    void add_viewer(const std::shared_ptr<viewer_t>& viewer)
+    {
+        viewers_.push_back(viewer);
+        if (!running_) {
+            running_ = true;
+            net::co_spawn(
+                ioc_,
+                [self = shared_from_this()]() -> net::awaitable<void> {
+                    co_await self->run();
+                },
+                net::detached);
+        }
+    }
+
+private:
+    net::awaitable<void> run()
+    {
+        net::steady_timer timer{ioc_};
+        while (has_viewers()) {
+            try {
+                co_await relay_frames();
+            }
+            catch (const boost::system::system_error& exc) {
+                spdlog::warn(
+                    "lost spectator feed of world {}: {}", world_, exc.what());
+            }
+            if (!has_viewers()) {
+                break;
+            }
+            timer.expires_after(reconnect_delay);
+            co_await timer.async_wait(net::use_awaitable);
+        }
+        running_ = false;
+    }
+
+    net::awaitable<void> relay_frames()
+    {
+        local_stream::socket socket{ioc_};
+        co_await socket.async_connect({path_}, net::use_awaitable);
+        const auto request = std::to_string(world_) + "\n";
+        co_await net::async_write(
+            socket, net::buffer(request), net::use_awaitable);
+        spdlog::info("subscribed to world {}", world_);
+
+        frame_header_t header{};
+        while (has_viewers()) {
+            co_await net::async_read(
+                socket, net::buffer(header), net::use_awaitable);
+            const auto size = decode_frame_header(header);
+            if (size > max_frame_size) {
+                spdlog::error("invalid frame size {}", size);
+                co_return;
+            }
+
+            std::string payload(size, '\0');
+            co_await net::async_read(
+                socket, net::buffer(payload), net::use_awaitable);
+
+            const auto frame =
+                std::make_shared<const std::string>(std::move(payload));
+            for (const auto& weak : viewers_) {
+                if (auto viewer = weak.lock()) {
+                    viewer->push(frame);
+                }
+            }
+        }
+        spdlog::info("no more viewers for world {}", world_);
+    }
+
+    bool has_viewers()
+    {
+        auto end_it = std::remove_if(
+            begin(viewers_), end(viewers_), [](const auto& weak) {
+                return weak.expired();
+            });
+        viewers_.erase(end_it, end(viewers_));
+        return !viewers_.empty();
+    }
+
+    net::io_context& ioc_;
+    std::string path_;
+    std::size_t world_;
+    bool running_{false};
+    std::vector<std::weak_ptr<viewer_t>> viewers_;
+};
+
+class relay_t : public std::enable_shared_from_this<relay_t> {
+public:
+    relay_t(
+        net::io_context& ioc,
+        const tcp::endpoint& endpoint,
+        std::string upstream_path)
+        : ioc_{ioc}, acceptor_{ioc}, upstream_path_{std::move(upstream_path)}
+    {
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(net::socket_base::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen(net::socket_base::max_listen_connections);
+    }
+
+    void run()
+    {
+        net::co_spawn(
+            ioc_,
+            [self = shared_from_this()]() -> net::awaitable<void> {
+                co_await self->on_run();
+            },
+            net::detached);
+    }
+
+private:
+    net::awaitable<void> on_run()
+    {
+        spdlog::info(
+            "relaying {} on {}:{}",
+            upstream_path_,
+            acceptor_.local_endpoint().address().to_string(),
+            acceptor_.local_endpoint().port());
+
+        while (true) {
+            auto socket = co_await acceptor_.async_accept(net::use_awaitable);
+            net::co_spawn(
+                ioc_,
+                [self = shared_from_this(),
+                 socket = std::move(socket)]() mutable -> net::awaitable<void> {
+                    co_await self->serve(std::move(socket));
+                },
+                net::detached);
+        }
+    }
+
+    net::awaitable<void> serve(tcp::socket socket)
+    {
+        plain_websocket_t ws{std::move(socket)};
+        ws.set_option(
+            websocket::stream_base::timeout::suggested(beast::role_type::server));
+
+        // the world is selected in the target: /spectate?world=3
+        beast::flat_buffer buffer;
+        http::request<http::empty_body> request;
+        co_await http::async_read(
+            ws.next_layer(), buffer, request, net::use_awaitable);
+        co_await ws.async_accept(request, net::use_awaitable);
+
+        auto viewer = std::make_shared<viewer_t>(std::move(ws));
+        upstream_for(world_from_target(request.target()))->add_viewer(viewer);
+
+        net::co_spawn(
+            ioc_,
+            [viewer]() -> net::awaitable<void> {
+                co_await viewer->write_loop();
+            },
+            net::detached);
+        try {
+            co_await viewer->read_loop();
+        }
+        catch (const boost::system::system_error&) {
+        }
+        viewer->close();
+    }
+
+    std::shared_ptr<upstream_t> upstream_for(std::size_t world)
+    {
+        auto& upstream = upstreams_[world];
+        if (!upstream) {
+            upstream =
+                std::make_shared<upstream_t>(ioc_, upstream_path_, world);
+        }
+        return upstream;
+    }
+
+    static std::size_t world_from_target(beast::string_view target)
+    {
+        constexpr beast::string_view key = "world=";
+        std::size_t world = 0;
+        if (auto pos = target.find(key); pos != beast::string_view::npos) {
+            const auto value = target.substr(pos + key.size());
+            std::from_chars(value.data(), value.data() + value.size(), world);
+        }
+        return world;
+    }
+
+    net::io_context& ioc_;
+    tcp::acceptor acceptor_;
+    std::string upstream_path_;
+    std::map<std::size_t, std::shared_ptr<upstream_t>> upstreams_;
+};
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto* mb_address = std::getenv(addr_envvar);
+    const auto* mb_port = std::getenv(port_envvar);
+    const auto* mb_path = std::getenv(spectator_socket_envvar);
+    if (mb_address == nullptr || mb_port == nullptr || mb_path == nullptr) {
+        std::cerr << "Environment variables " << addr_envvar << ", "
+                  << port_envvar << " and " << spectator_socket_envvar
+                  << " must be defined" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto address = net::ip::make_address(mb_address);
+    const auto port = static_cast<unsigned short>(std::atoi(mb_port));
+
+    net::io_context ioc{1};
+    std::make_shared<relay_t>(ioc, tcp::endpoint{address, port}, mb_path)
+        ->run();
+
+    net::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait([&](const beast::error_code&, int) { ioc.stop(); });
+
+    ioc.run();
+
+    return EXIT_SUCCESS;
+}
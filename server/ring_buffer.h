@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace sd {
+
+// Bounded multi-producer, multi-consumer lock-free queue
+// (Dmitry Vyukov's algorithm). The capacity is rounded
+// up to the next power of two and allocated once,
+// pushing and popping never allocate.
+template <typename T>
+class ring_buffer_t {
+public:
+    explicit ring_buffer_t(std::size_t capacity)
+        : capacity_{round_up_pow2(capacity)},
+          mask_{capacity_ - 1},
+          cells_{std::make_unique<cell_t[]>(capacity_)}
+    {
+        for (std::size_t i = 0; i < capacity_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ring_buffer_t(const ring_buffer_t&) = delete;
+    ring_buffer_t(ring_buffer_t&&) = delete;
+    ring_buffer_t& operator=(const ring_buffer_t&) = delete;
+    ring_buffer_t& operator=(ring_buffer_t&&) = delete;
+
+    [[nodiscard]] std::size_t capacity() const { return capacity_; }
+
+    bool try_push(const T& value)
+    {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells_[pos & mask_];
+            const auto seq = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq)
+                              - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                // full
+                return false;
+            }
+            else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value)
+    {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells_[pos & mask_];
+            const auto seq = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq)
+                              - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(
+                        pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                // empty
+                return false;
+            }
+            else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct cell_t {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static std::size_t round_up_pow2(std::size_t v)
+    {
+        std::size_t res = 2;
+        while (res < v) {
+            res <<= 1;
+        }
+        return res;
+    }
+
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    std::unique_ptr<cell_t[]> cells_;
+    alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos_{0};
+    alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos_{0};
+};
+
+} // sd
@@ -0,0 +1,379 @@
+#include "router.h"
+#include "world.h"
+#include "tick_scheduler.h"
+
+#include <sstream>
+
+#include <boost/uuid/string_generator.hpp>
+#include <spdlog/spdlog.h>
+
+#include <unistd.h>
+
+namespace sd {
+
+namespace {
+
+constexpr auto handshake_timeout = std::chrono::seconds{30};
+constexpr auto reconnect_delay = std::chrono::seconds{1};
+// a backend missing this many reports is considered gone
+constexpr auto backend_timeout = 3 * occupancy_report_period;
+constexpr std::size_t max_request_size = 8192;
+constexpr std::size_t max_report_size = 1024;
+constexpr std::size_t copy_buffer_size = 16384;
+
+// The client and backend sides of a forwarded connection
+struct connection_t {
+    connection_t(tcp::socket&& client_socket, net::io_context& ioc)
+        : client{std::move(client_socket)}, backend{ioc}
+    {
+    }
+
+    void close()
+    {
+        boost::system::error_code ec;
+        client.close(ec);
+        backend.close(ec);
+    }
+
+    tcp::socket client;
+    local_stream::socket backend;
+};
+
+template <typename From, typename To>
+net::awaitable<void> copy(From& from, To& to)
+{
+    std::array<char, copy_buffer_size> buffer{};
+    boost::system::error_code ec;
+    while (!ec) {
+        const auto size = co_await from.async_read_some(
+            net::buffer(buffer), net::redirect_error(net::use_awaitable, ec));
+        if (!ec) {
+            co_await net::async_write(
+                to,
+                net::buffer(buffer.data(), size),
+                net::redirect_error(net::use_awaitable, ec));
+        }
+    }
+}
+
+// The client passes its player ID in the upgrade request: /ws?id=...
+std::optional<player_id_t> player_id_from_request(std::string_view request)
+{
+    const auto target_begin = request.find(' ');
+    const auto target_end = request.find(' ', target_begin + 1);
+    if (target_begin == std::string_view::npos
+        || target_end == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    const auto target =
+        request.substr(target_begin + 1, target_end - target_begin - 1);
+    auto pos = target.find("?id=");
+    if (pos == std::string_view::npos) {
+        pos = target.find("&id=");
+    }
+    if (pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    auto value = target.substr(pos + 4); // NOLINT(*-magic-numbers)
+    value = value.substr(0, value.find('&'));
+    try {
+        return boost::uuids::string_generator{}(begin(value), end(value));
+    }
+    catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
+
+}
+
+router_t::router_t(net::io_context& ioc, const std::string& report_path)
+    : ioc_{ioc}, report_acceptor_{ioc}
+{
+    // remove the socket left by a previous run
+    ::unlink(report_path.c_str());
+
+    const local_stream::endpoint endpoint{report_path};
+    report_acceptor_.open(endpoint.protocol());
+    report_acceptor_.bind(endpoint);
+    report_acceptor_.listen(net::socket_base::max_listen_connections);
+}
+
+void router_t::run()
+{
+    net::co_spawn(
+        ioc_,
+        [self = shared_from_this()]() -> net::awaitable<void> {
+            co_await self->accept_reports();
+        },
+        net::detached);
+}
+
+void router_t::route(tcp::socket&& socket)
+{
+    net::co_spawn(
+        ioc_,
+        [self = shared_from_this(),
+         socket = std::move(socket)]() mutable -> net::awaitable<void> {
+            try {
+                co_await self->forward(std::move(socket));
+            }
+            catch (const boost::system::system_error& exc) {
+                spdlog::debug("forwarding error: {}", exc.what());
+            }
+        },
+        net::detached);
+}
+
+net::awaitable<void> router_t::accept_reports()
+{
+    spdlog::info(
+        "waiting for backend reports on {}",
+        report_acceptor_.local_endpoint().path());
+
+    while (true) {
+        auto socket =
+            co_await report_acceptor_.async_accept(net::use_awaitable);
+        net::co_spawn(
+            ioc_,
+            [self = shared_from_this(),
+             socket = std::move(socket)]() mutable -> net::awaitable<void> {
+                co_await self->read_reports(std::move(socket));
+            },
+            net::detached);
+    }
+}
+
+net::awaitable<void> router_t::read_reports(local_stream::socket socket)
+{
+    const auto stream = ++report_streams_;
+    std::optional<std::string> path;
+    std::string buffer;
+    while (true) {
+        boost::system::error_code ec;
+        const auto size = co_await net::async_read_until(
+            socket,
+            net::dynamic_buffer(buffer, max_report_size),
+            '\n',
+            net::redirect_error(net::use_awaitable, ec));
+        if (ec) {
+            break;
+        }
+
+        std::istringstream line{buffer.substr(0, size - 1)};
+        buffer.erase(0, size);
+
+        std::string reported_path;
+        backend_t backend{};
+        if (!(line >> reported_path >> backend.available_places
+              >> backend.players)) {
+            spdlog::warn("invalid backend report");
+            break;
+        }
+        backend.last_report = clock_t::now();
+        backend.stream = stream;
+
+        if (!path) {
+            spdlog::info("backend {} joined", reported_path);
+        }
+        path = std::move(reported_path);
+        backends_[*path] = backend;
+    }
+
+    // unless it already reports again on a new stream
+    if (auto it = path ? backends_.find(*path) : end(backends_);
+        it != end(backends_) && it->second.stream == stream) {
+        spdlog::warn("backend {} left", *path);
+        backends_.erase(it);
+    }
+}
+
+net::awaitable<void> router_t::forward(tcp::socket socket)
+{
+    std::string request;
+    {
+        beast::tcp_stream client{std::move(socket)};
+        client.expires_after(handshake_timeout);
+        co_await net::async_read_until(
+            client,
+            net::dynamic_buffer(request, max_request_size),
+            "\r\n\r\n",
+            net::use_awaitable);
+        client.expires_never();
+        socket = client.release_socket();
+    }
+
+    const auto player_id = player_id_from_request(request);
+    auto connection = std::make_shared<connection_t>(std::move(socket), ioc_);
+    while (true) {
+        const auto backend = pick_backend(player_id);
+        if (!backend) {
+            spdlog::warn("no backend available");
+            co_return;
+        }
+
+        boost::system::error_code ec;
+        co_await connection->backend.async_connect(
+            {*backend}, net::redirect_error(net::use_awaitable, ec));
+        if (!ec) {
+            break;
+        }
+
+        // it will join again with its next report
+        spdlog::warn("backend {} unreachable: {}", *backend, ec.message());
+        backends_.erase(*backend);
+        connection->backend.close(ec);
+    }
+
+    // everything read so far, the upgrade request and whatever
+    // followed it, goes to the backend unchanged
+    co_await net::async_write(
+        connection->backend, net::buffer(request), net::use_awaitable);
+
+    net::co_spawn(
+        ioc_,
+        [connection]() -> net::awaitable<void> {
+            co_await copy(connection->backend, connection->client);
+            connection->close();
+        },
+        net::detached);
+    co_await copy(connection->client, connection->backend);
+    connection->close();
+
+    if (player_id) {
+        // the backend keeps the place reserved for a while
+        if (auto it = affinities_.find(*player_id); it != end(affinities_)) {
+            it->second.expires = clock_t::now() + world_t::idle_duration;
+        }
+    }
+}
+
+std::optional<std::string> router_t::pick_backend(
+    const std::optional<player_id_t>& player_id)
+{
+    const auto now = clock_t::now();
+    if (now - last_cleanup_ > occupancy_report_period) {
+        cleanup(now);
+    }
+
+    auto backend_it = end(backends_);
+    if (player_id) {
+        if (auto it = affinities_.find(*player_id); it != end(affinities_)) {
+            backend_it = backends_.find(it->second.backend);
+        }
+    }
+    if (backend_it == end(backends_)) {
+        // most places available first, then the least loaded
+        backend_it = std::max_element(
+            begin(backends_), end(backends_), [](const auto& a, const auto& b) {
+                return std::pair{a.second.available_places, b.second.players}
+                       < std::pair{b.second.available_places, a.second.players};
+            });
+    }
+    if (backend_it == end(backends_)) {
+        return std::nullopt;
+    }
+
+    // account for this player until the next report
+    auto& backend = backend_it->second;
+    if (backend.available_places > 0) {
+        --backend.available_places;
+    }
+    ++backend.players;
+
+    if (player_id) {
+        affinities_[*player_id] = {backend_it->first, clock_t::time_point::max()};
+    }
+    return backend_it->first;
+}
+
+void router_t::cleanup(clock_t::time_point now)
+{
+    for (auto it = begin(backends_); it != end(backends_);) {
+        if (now - it->second.last_report > backend_timeout) {
+            spdlog::warn("backend {} stopped reporting", it->first);
+            it = backends_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    for (auto it = begin(affinities_); it != end(affinities_);) {
+        if (now > it->second.expires) {
+            it = affinities_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    last_cleanup_ = now;
+}
+
+occupancy_reporter_t::occupancy_reporter_t(
+    net::io_context& ioc,
+    std::vector<std::shared_ptr<world_t>> worlds,
+    std::string router_path,
+    std::string backend_path)
+    : ioc_{ioc},
+      worlds_{std::move(worlds)},
+      router_path_{std::move(router_path)},
+      backend_path_{std::move(backend_path)}
+{
+}
+
+void occupancy_reporter_t::run()
+{
+    net::co_spawn(
+        ioc_,
+        [self = shared_from_this()]() -> net::awaitable<void> {
+            co_await self->on_run();
+        },
+        net::detached);
+}
+
+net::awaitable<void> occupancy_reporter_t::on_run()
+{
+    net::steady_timer timer{ioc_};
+    while (true) {
+        try {
+            local_stream::socket socket{ioc_};
+            co_await socket.async_connect({router_path_}, net::use_awaitable);
+            spdlog::info("reporting occupancy to {}", router_path_);
+            co_await report(socket);
+        }
+        catch (const boost::system::system_error& exc) {
+            spdlog::debug("occupancy report error: {}", exc.what());
+        }
+
+        timer.expires_after(reconnect_delay);
+        co_await timer.async_wait(net::use_awaitable);
+    }
+}
+
+net::awaitable<void> occupancy_reporter_t::report(local_stream::socket& socket)
+{
+    net::steady_timer timer{ioc_};
+    while (true) {
+        std::size_t available_places = 0;
+        std::size_t players = 0;
+        for (const auto& world : worlds_) {
+            available_places += world->available_places();
+            players += world->real_players();
+        }
+        if (tick_scheduler_t::of(ioc_.get_executor()).saturated()) {
+            // more players would make the ticks late
+            available_places = 0;
+        }
+
+        const auto line = fmt::format(
+            "{} {} {}\n", backend_path_, available_places, players);
+        co_await net::async_write(
+            socket, net::buffer(line), net::use_awaitable);
+
+        timer.expires_after(occupancy_report_period);
+        co_await timer.async_wait(net::use_awaitable);
+    }
+}
+
+} // sd
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+namespace sd {
+
+// Backends report their occupancy to the router over a local socket,
+// one line per report: "<backend socket path> <available places> <players>".
+// A backend that stops reporting is forgotten by the router.
+constexpr auto occupancy_report_period = std::chrono::seconds{1};
+
+// Front of a multi-process deployment: client connections are forwarded
+// to the backend processes over their local socket. The upgrade request
+// is only read to find the player ID, then the bytes are copied as-is
+// both ways and the backend does the websocket handshake itself.
+class router_t : public std::enable_shared_from_this<router_t> {
+public:
+    router_t(net::io_context& ioc, const std::string& report_path);
+
+    // accept the occupancy reports of the backends
+    void run();
+    void route(tcp::socket&& socket);
+
+private:
+    using clock_t = std::chrono::steady_clock;
+    struct backend_t {
+        std::size_t available_places;
+        std::size_t players;
+        clock_t::time_point last_report;
+        // report stream of the backend, a reconnected backend reports on
+        // a new one while the previous one may not have ended yet
+        std::uint64_t stream;
+    };
+    struct affinity_t {
+        std::string backend;
+        clock_t::time_point expires;
+    };
+
+    net::awaitable<void> accept_reports();
+    net::awaitable<void> read_reports(local_stream::socket socket);
+    net::awaitable<void> forward(tcp::socket socket);
+    std::optional<std::string> pick_backend(
+        const std::optional<player_id_t>& player_id);
+    void cleanup(clock_t::time_point now);
+
+    net::io_context& ioc_;
+    local_stream::acceptor report_acceptor_;
+    std::map<std::string, backend_t> backends_;
+    std::uint64_t report_streams_{0};
+    // players go back to the backend where they have a reserved place
+    std::map<player_id_t, affinity_t> affinities_;
+    clock_t::time_point last_cleanup_;
+};
+
+// Backend side: reports the occupancy of the worlds to the router
+class occupancy_reporter_t
+    : public std::enable_shared_from_this<occupancy_reporter_t> {
+public:
+    occupancy_reporter_t(
+        net::io_context& ioc,
+        std::vector<std::shared_ptr<world_t>> worlds,
+        std::string router_path,
+        std::string backend_path);
+
+    void run();
+
+private:
+    net::awaitable<void> on_run();
+    net::awaitable<void> report(local_stream::socket& socket);
+
+    net::io_context& ioc_;
+    std::vector<std::shared_ptr<world_t>> worlds_;
+    std::string router_path_;
+    std::string backend_path_;
+};
+
+} // sd
@@ -1,4 +1,8 @@
 #include "session.h"
+#include "event_log.h"
+#include "process_stats.h"
+#include "trace.h"
+#include "waiting_room.h"
 #include "world.h"
 
 #include <optional>
@@ -10,7 +14,9 @@ namespace sd {
 namespace {
 
 constexpr auto keepalive_period = std::chrono::seconds{60};
-constexpr auto player_name_max_length = 30;
+constexpr auto ping_period = std::chrono::seconds{5};
+// same as the websocket handshake timeout
+constexpr auto tls_handshake_timeout = std::chrono::seconds{30};
 
 bool player_name_is_valid(std::string_view name)
 {
@@ -19,67 +25,150 @@ bool player_name_is_valid(std::string_view name)
 
 }
 
-session_t::session_t(std::shared_ptr<world_t> world, tcp::socket&& socket)
-    : world_{std::move(world)}, ws_{std::move(socket)}, timer_{ws_.get_executor()}
+net::awaitable<std::string> accept_registration(websocket_stream_t& ws)
 {
-}
-
-void session_t::run()
-{
-    net::co_spawn(
-        ws_.get_executor(),
-        [self = shared_from_this()]() -> net::awaitable<void> {
-            co_await self->do_run();
-        },
-        net::detached);
-}
+    // wss:// connections, the websocket timeouts don't cover it
+    if (auto* tls = ws.next_layer().tls()) {
+        auto& plain = ws.next_layer().plain();
+        plain.expires_after(tls_handshake_timeout);
+        co_await tls->async_handshake(
+            net::ssl::stream_base::server, net::use_awaitable);
+        plain.expires_never();
+    }
 
-net::awaitable<void> session_t::do_run()
-{
     // Set suggested timeout settings for the websocket
-    ws_.set_option(
+    ws.set_option(
         websocket::stream_base::timeout::suggested(beast::role_type::server));
 
     // Accept the websocket handshake
-    co_await ws_.async_accept(net::use_awaitable);
+    co_await ws.async_accept(net::use_awaitable);
 
-    // Handle client registration
+    // Read the client registration
     std::string str_buffer;
     auto buffer = net::dynamic_buffer(str_buffer);
-    co_await ws_.async_read(buffer, net::use_awaitable);
-    auto registration = nlohmann::json::parse(
-        str_buffer)["command"]["register"];
-    auto player_id = registration["id"];
-    auto player_name = registration["name"];
+    co_await ws.async_read(buffer, net::use_awaitable);
+    co_return str_buffer;
+}
+
+registration_t parse_registration(const std::string& msg)
+{
+    nlohmann::json player_id;
+    nlohmann::json player_name;
+    try {
+        auto registration = nlohmann::json::parse(msg)["command"]["register"];
+        player_id = registration["id"];
+        player_name = registration["name"];
+    }
+    catch (const nlohmann::json::exception&) {
+        // reported below, the id and name are not strings
+    }
 
     if (!player_id.is_string() || !player_name.is_string()) {
-        spdlog::warn("client failed to register");
-        co_await ws_.async_close(
-            beast::websocket::close_reason{"registration error"},
-            net::use_awaitable);
-        co_return;
+        log_player_event(event_kind_t::registration_failed, {}, {});
+        throw registration_error{"registration error"};
     }
 
     if (!player_name_is_valid(player_name.get<std::string>())) {
-        co_await ws_.async_close(
-            beast::websocket::close_reason{"invalid name"}, net::use_awaitable);
-        co_return;
+        throw registration_error{"invalid name"};
     }
 
-    std::optional<beast::websocket::close_reason> close_reason;
     try {
-        player_ = world_->register_player(
+        return {
             boost::uuids::string_generator{}(player_id.get<std::string>()),
-            player_name.get<std::string>());
+            player_name.get<std::string>(),
+        };
     }
-    catch (const player_already_registered& exc) {
-        close_reason.emplace(exc.what());
+    catch (const std::runtime_error&) {
+        log_player_event(event_kind_t::registration_failed, {}, {});
+        throw registration_error{"registration error"};
     }
-    if (close_reason) {
-        co_await ws_.async_close(*close_reason, net::use_awaitable);
-        co_return;
+}
+
+session_t::session_t(
+    std::shared_ptr<world_t> world,
+    client_stream_t&& stream,
+    std::weak_ptr<waiting_room_t> waiting_room)
+    : world_{std::move(world)},
+      waiting_room_{std::move(waiting_room)},
+      ws_{std::move(stream)},
+      timing_wheel_{timing_wheel_t::of(ws_.get_executor())}
+{
+    live_sessions.fetch_add(1, std::memory_order_relaxed);
+    keepalive_.on_expired([this]() { on_keepalive_expired(); });
+    ping_.on_expired([this]() { on_ping_due(); });
+}
+
+session_t::session_t(
+    std::shared_ptr<world_t> world,
+    player_handle_t player,
+    websocket_stream_t&& ws)
+    : world_{std::move(world)},
+      player_{std::move(player)},
+      ws_{std::move(ws)},
+      timing_wheel_{timing_wheel_t::of(ws_.get_executor())}
+{
+    live_sessions.fetch_add(1, std::memory_order_relaxed);
+    keepalive_.on_expired([this]() { on_keepalive_expired(); });
+    ping_.on_expired([this]() { on_ping_due(); });
+}
+
+session_t::~session_t()
+{
+    live_sessions.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void session_t::run()
+{
+    net::co_spawn(
+        ws_.get_executor(),
+        [self = shared_from_this()]() -> net::awaitable<void> {
+            co_await self->do_run();
+        },
+        net::detached);
+}
+
+net::awaitable<void> session_t::do_run()
+{
+    // Handle client registration, unless it was done by the waiting room
+    if (!player_) {
+        auto msg = co_await accept_registration(ws_);
+
+        std::optional<beast::websocket::close_reason> close_reason;
+        registration_t registration;
+        try {
+            registration = parse_registration(msg);
+            player_ = world_->register_player(
+                registration.player_id, registration.player_name);
+        }
+        catch (const registration_error& exc) {
+            close_reason.emplace(exc.what());
+        }
+        catch (const player_already_registered& exc) {
+            close_reason.emplace(exc.what());
+        }
+        catch (const world_full& exc) {
+            // the last places went to concurrent registrations, waiting
+            // spares the client a reconnection
+            if (auto room = waiting_room_.lock(); room && !room->full()) {
+                room->enter(std::move(ws_), std::move(registration));
+                co_return;
+            }
+            close_reason.emplace(exc.what());
+        }
+        if (close_reason) {
+            co_await ws_.async_close(*close_reason, net::use_awaitable);
+            co_return;
+        }
     }
 
+    // pongs are received by the read loop
+    ws_.control_callback(
+        [this](websocket::frame_type kind, beast::string_view /*payload*/) {
+            if (kind == websocket::frame_type::pong) {
+                on_pong();
+            }
+        });
+
     // Start the receive and send loops
     auto executor = co_await net::this_coro::executor;
     net::co_spawn(
@@ -94,12 +183,8 @@ net::awaitable<void> session_t::do_run()
             co_await self->write_loop();
         },
         net::detached);
-    net::co_spawn(
-        executor,
-        [self = shared_from_this()]() -> net::awaitable<void> {
-            co_await self->keepalive();
-        },
-        net::detached);
+    timing_wheel_.expires_after(keepalive_, keepalive_period);
+    timing_wheel_.expires_after(ping_, ping_period);
 }
 
 net::awaitable<void> session_t::read_loop()
@@ -115,6 +200,8 @@ net::awaitable<void> session_t::read_loop()
             break;
         }
 
+        // the completion only, the wait for the next message is not a span
+        SD_TRACE_SCOPE("session_t::on_read");
         auto msg = nlohmann::json::parse(str_buffer);
         if (msg.contains("command")) {
             handle_command(msg["command"]);
@@ -122,8 +209,11 @@ net::awaitable<void> session_t::read_loop()
         if (msg.contains("input")) {
             handle_input(msg["input"]);
         }
+        if (msg.contains("tick") && msg["tick"].is_number_unsigned()) {
+            handle_ack(msg["tick"].get<std::uint64_t>());
+        }
 
-        timer_.cancel();
+        timing_wheel_.expires_after(keepalive_, keepalive_period);
     }
 
     // handle socket errors/close in read_loop
@@ -138,44 +228,48 @@ net::awaitable<void> session_t::write_loop()
     timer.expires_from_now(std::chrono::seconds{0});
 
     while (ws_.is_open()) {
-        auto msg = world_->game_state_for_player(player_).dump();
-        co_await ws_.async_write(net::buffer(msg), net::use_awaitable);
+        {
+            SD_TRACE_SCOPE("session_t::serialize_state");
+            // copied, the world reuses its buffer for the next player
+            state_msg_ = world_->encode_state_for_player(player_);
+        }
+        // the world may tick again while the message is written
+        const auto tick = world_->current_tick();
+        co_await ws_.async_write(net::buffer(state_msg_), net::use_awaitable);
+        {
+            SD_TRACE_SCOPE("session_t::on_write");
+            on_state_sent(tick);
+        }
 
         timer.expires_at(timer.expires_at() + world_t::refresh_dt);
         co_await timer.async_wait(net::use_awaitable);
     }
 }
 
-net::awaitable<void> session_t::keepalive()
+void session_t::on_keepalive_expired()
 {
-    while (ws_.is_open()) {
-        std::optional<beast::websocket::close_reason> reason;
-        try {
-            timer_.expires_from_now(keepalive_period);
-            co_await timer_.async_wait(net::use_awaitable);
-            if (player_->alive()) {
-                // still alive despite no command, let this one open
-                continue;
+    if (!ws_.is_open()) {
+        return;
+    }
+    if (player_ && player_->alive()) {
+        // still alive despite no command, let this one open
+        timing_wheel_.expires_after(keepalive_, keepalive_period);
+        return;
+    }
+
+    net::co_spawn(
+        ws_.get_executor(),
+        [self = shared_from_this()]() -> net::awaitable<void> {
+            try {
+                co_await self->ws_.async_close(
+                    beast::websocket::close_reason{"idle for too long"},
+                    net::use_awaitable);
             }
-            reason.emplace("idle for too long");
-        }
-        catch (const boost::system::system_error& exc) {
-            if (exc.code() == net::error::operation_aborted) {
-                continue;
+            catch (const boost::system::system_error& exc) {
+                spdlog::error("unexpected exception: {}", exc.what());
             }
-            spdlog::error("unexpected exception: {}", exc.what());
-            reason.emplace(exc.what());
-        }
-        catch (const std::exception& exc) {
-            spdlog::error("unexpected exception: {}", exc.what());
-            reason.emplace(exc.what());
-        }
-
-        if (reason) {
-            co_await ws_.async_close(*reason, net::use_awaitable);
-            break;
-        }
-    }
+        },
+        net::detached);
 }
 
 void session_t::cleanup()
@@ -186,21 +280,90 @@ void session_t::cleanup()
     boost::system::error_code ec;
     ws_.close(beast::websocket::close_reason{"session closed"}, ec);
 
-    // cancel the timer so that the keepalive coroutine returns asap
-    timer_.cancel();
+    timing_wheel_.cancel(keepalive_);
+    timing_wheel_.cancel(ping_);
+}
+
+void session_t::on_ping_due()
+{
+    if (!ws_.is_open()) {
+        return;
+    }
+    timing_wheel_.expires_after(ping_, ping_period);
+    if (ping_sent_at_) {
+        // no pong yet, the keepalive deals with dead clients
+        return;
+    }
+
+    ping_sent_at_ = clock_t::now();
+    net::co_spawn(
+        ws_.get_executor(),
+        [self = shared_from_this()]() -> net::awaitable<void> {
+            try {
+                co_await self->ws_.async_ping({}, net::use_awaitable);
+            }
+            catch (const boost::system::system_error&) {
+                // the read loop handles the errors
+            }
+        },
+        net::detached);
+}
+
+void session_t::on_pong()
+{
+    if (!ping_sent_at_) {
+        // unsolicited pong
+        return;
+    }
+    world_->latency_stats().ping_rtt.record(clock_t::now() - *ping_sent_at_);
+    ping_sent_at_.reset();
+}
+
+void session_t::on_state_sent(std::uint64_t tick)
+{
+    const auto now = clock_t::now();
+    sent_states_[tick % sent_states_.size()] = {tick, now};
+
+    // inputs are applied by the tick following their reception
+    if (pending_input_ && tick > pending_input_->tick) {
+        world_->latency_stats().input_to_broadcast.record(
+            now - pending_input_->received_at);
+        pending_input_.reset();
+    }
+}
+
+void session_t::handle_ack(std::uint64_t tick)
+{
+    // the same state is acknowledged by all the inputs sent while
+    // it is displayed, only the first one is measured
+    if (tick <= last_ack_) {
+        return;
+    }
+    last_ack_ = tick;
+
+    const auto& sent = sent_states_[tick % sent_states_.size()];
+    if (sent.tick != tick) {
+        return;
+    }
+    world_->latency_stats().broadcast_to_ack.record(
+        clock_t::now() - sent.sent_at);
 }
 
 void session_t::handle_command(const nlohmann::json& command)
 {
-    if (!player_->alive() && command.contains("respawn")) {
-        player_->respawn();
+    if (command.contains("respawn")) {
+        player_->input().request_respawn();
     }
 }
 
 void session_t::handle_input(const nlohmann::json& input)
 {
     if (input.contains("ddx") && input.contains("ddy")) {
-        player_->set_dd(input["ddx"].get<double>(), input["ddy"].get<double>());
+        if (!pending_input_) {
+            pending_input_ = {clock_t::now(), world_->current_tick()};
+        }
+        player_->input().write_dd(
+            input["ddx"].get<double>(), input["ddy"].get<double>());
     }
 }
 
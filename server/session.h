@@ -1,20 +1,55 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <boost/beast.hpp>
 #include <nlohmann/json.hpp>
 
+#include "client_stream.h"
 #include "config.h"
 #include "player.h"
+#include "player_handle.h"
+#include "timing_wheel.h"
 
 namespace sd {
 
+class waiting_room_t;
+
+class registration_error : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+struct registration_t {
+    player_id_t player_id;
+    std::string player_name;
+};
+
+// Accept the websocket handshake and read the registration message
+net::awaitable<std::string> accept_registration(websocket_stream_t& ws);
+// Throws registration_error, its message is the close reason
+registration_t parse_registration(const std::string& msg);
+
 class session_t : public std::enable_shared_from_this<session_t> {
 public:
-    session_t(std::shared_ptr<world_t> world, tcp::socket&& socket);
-    ~session_t() = default;
+    // clients losing the race for the last places of the world go to
+    // the waiting room instead of being closed
+    session_t(
+        std::shared_ptr<world_t> world,
+        client_stream_t&& stream,
+        std::weak_ptr<waiting_room_t> waiting_room);
+    // the websocket is already accepted and the player registered
+    session_t(
+        std::shared_ptr<world_t> world,
+        player_handle_t player,
+        websocket_stream_t&& ws);
+    ~session_t();
 
     session_t(const session_t&) = delete;
     session_t(session_t&&) = delete;
@@ -28,16 +63,43 @@ private:
     net::awaitable<void> do_run();
     net::awaitable<void> read_loop();
     net::awaitable<void> write_loop();
-    net::awaitable<void> keepalive();
+    void on_keepalive_expired();
+    void on_ping_due();
+    void on_pong();
+    void on_state_sent(std::uint64_t tick);
+    void handle_ack(std::uint64_t tick);
     void cleanup();
 
     void handle_command(const nlohmann::json& command);
     void handle_input(const nlohmann::json& input);
 
     std::shared_ptr<world_t> world_;
+    std::weak_ptr<waiting_room_t> waiting_room_;
     player_handle_t player_;
-    websocket::stream<beast::tcp_stream> ws_;
-    net::steady_timer timer_;
+    websocket_stream_t ws_;
+    // touched by each message, shared with the other sessions
+    timing_wheel_t& timing_wheel_;
+    timing_wheel_t::entry_t keepalive_;
+
+    // latency measurements, recorded in the stats of the world
+    using clock_t = std::chrono::steady_clock;
+    struct pending_input_t {
+        clock_t::time_point received_at;
+        std::uint64_t tick;
+    };
+    struct sent_state_t {
+        std::uint64_t tick;
+        clock_t::time_point sent_at;
+    };
+    timing_wheel_t::entry_t ping_;
+    std::optional<clock_t::time_point> ping_sent_at_;
+    // oldest input not yet reflected by a state sent
+    std::optional<pending_input_t> pending_input_;
+    // acks older than this are not measured
+    std::array<sent_state_t, 64> sent_states_{};
+    std::uint64_t last_ack_{0};
+    // reused from one state message to the next
+    std::string state_msg_;
 };
 
 } // sd
@@ -0,0 +1,122 @@
+// Example consumer of the shared-memory export: follows the snapshots of
+// all the worlds of a server started with $SHM_EXPORT and prints, every
+// second, the ticks read and lost per world and the current leader.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "shm_reader.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto shm_export_envvar = "SHM_EXPORT";
+constexpr auto duration_envvar = "SHM_CONSUMER_DURATION";
+
+// well under a tick, the ring holds more than a second anyway
+constexpr auto poll_period = std::chrono::milliseconds{5};
+constexpr auto report_period = std::chrono::seconds{1};
+
+struct world_progress_t {
+    std::uint64_t next_tick{0};
+    std::int64_t read{0};
+    std::int64_t lost{0};
+};
+
+void report(
+    std::size_t index,
+    const world_progress_t& progress,
+    const shm_snapshot_t& last)
+{
+    const shm_player_t* leader = nullptr;
+    for (std::uint32_t i = 0; i < last.player_count; ++i) {
+        const auto& player = last.players[i];
+        if (leader == nullptr || player.score > leader->score) {
+            leader = &player;
+        }
+    }
+    if (leader == nullptr) {
+        spdlog::info(
+            "world {}: {} ticks read, {} lost, no player",
+            index,
+            progress.read,
+            progress.lost);
+        return;
+    }
+    spdlog::info(
+        "world {}: {} ticks read, {} lost, tick {}, {} players, leader {} "
+        "({:.0f})",
+        index,
+        progress.read,
+        progress.lost,
+        last.tick,
+        last.player_count,
+        std::string_view{leader->name.data(), leader->name_size},
+        leader->score);
+}
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto* name = std::getenv(shm_export_envvar);
+    if (name == nullptr) {
+        std::cerr << "Environment variable " << shm_export_envvar
+                  << " is not defined" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const auto* mb_duration = std::getenv(duration_envvar);
+    const auto duration = std::chrono::seconds{
+        mb_duration ? std::atol(mb_duration) : 0};
+
+    const shm_reader_t reader{name};
+    std::vector<world_progress_t> progress(reader.world_count());
+    std::vector<shm_snapshot_t> last(reader.world_count());
+    for (std::size_t i = 0; i < reader.world_count(); ++i) {
+        progress[i].next_tick = reader.latest_tick(i) + 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto next_report = start + report_period;
+    shm_snapshot_t snapshot{};
+    while (duration.count() == 0
+           || std::chrono::steady_clock::now() < start + duration) {
+        for (std::size_t i = 0; i < reader.world_count(); ++i) {
+            auto& world = progress[i];
+            const auto latest = reader.latest_tick(i);
+            if (latest >= world.next_tick + shm_ring_size) {
+                // already overwritten
+                const auto oldest = latest - shm_ring_size + 1;
+                world.lost +=
+                    static_cast<std::int64_t>(oldest - world.next_tick);
+                world.next_tick = oldest;
+            }
+            for (; world.next_tick <= latest; ++world.next_tick) {
+                if (reader.read(i, world.next_tick, snapshot)) {
+                    ++world.read;
+                    last[i] = snapshot;
+                }
+                else {
+                    ++world.lost;
+                }
+            }
+        }
+
+        if (std::chrono::steady_clock::now() >= next_report) {
+            next_report += report_period;
+            for (std::size_t i = 0; i < reader.world_count(); ++i) {
+                report(i, progress[i], last[i]);
+                progress[i].read = progress[i].lost = 0;
+            }
+        }
+        std::this_thread::sleep_for(poll_period);
+    }
+    return EXIT_SUCCESS;
+}
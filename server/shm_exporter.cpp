@@ -0,0 +1,86 @@
+#include "shm_exporter.h"
+
+#include <cerrno>
+#include <new>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace sd {
+
+namespace {
+
+[[noreturn]] void throw_errno(const char* what)
+{
+    throw std::system_error{errno, std::generic_category(), what};
+}
+
+}
+
+shm_exporter_t::shm_exporter_t(std::string name, std::size_t world_count)
+    : name_{std::move(name)}, size_{shm_segment_size(world_count)}
+{
+    // a new segment each time, readers of the previous one keep it
+    ::shm_unlink(name_.c_str());
+    const auto fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw_errno("shm_open");
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+        ::close(fd);
+        ::shm_unlink(name_.c_str());
+        throw_errno("ftruncate");
+    }
+    data_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+        ::shm_unlink(name_.c_str());
+        throw_errno("mmap");
+    }
+
+    // the pages are zeroed: sequence numbers and latest ticks start at 0
+    auto* header = new (data_) shm_header_t{};
+    header->magic = shm_magic;
+    header->version = shm_version;
+    header->world_count = static_cast<std::uint32_t>(world_count);
+    header->ring_size = shm_ring_size;
+    header->max_players = shm_max_players;
+}
+
+shm_exporter_t::~shm_exporter_t()
+{
+    ::munmap(data_, size_);
+    ::shm_unlink(name_.c_str());
+}
+
+shm_snapshot_t& shm_exporter_t::begin_snapshot(
+    std::size_t world,
+    std::uint64_t tick)
+{
+    auto& slot = this->world(world).ring[tick % shm_ring_size];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    // the odd sequence number is visible before any write of the snapshot
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot.snapshot;
+}
+
+void shm_exporter_t::publish_snapshot(std::size_t world, std::uint64_t tick)
+{
+    auto& shm_world = this->world(world);
+    auto& slot = shm_world.ring[tick % shm_ring_size];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_release);
+    shm_world.latest_tick.store(tick, std::memory_order_release);
+}
+
+shm_world_t& shm_exporter_t::world(std::size_t index)
+{
+    auto* worlds = reinterpret_cast<shm_world_t*>( // NOLINT
+        static_cast<char*>(data_) + sizeof(shm_header_t));
+    return worlds[index];
+}
+
+} // sd
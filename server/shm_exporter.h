@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "shm_layout.h"
+
+namespace sd {
+
+// Publishes a snapshot of each world per tick into a POSIX shared-memory
+// segment, see shm_layout.h. Consumers map the segment and read it
+// without any syscall nor copy on the server side.
+class shm_exporter_t {
+public:
+    // creates the segment, replacing a stale one left by a previous run,
+    // throws std::system_error
+    shm_exporter_t(std::string name, std::size_t world_count);
+    // removes the segment, mapped readers keep their mapping
+    ~shm_exporter_t();
+
+    shm_exporter_t(const shm_exporter_t&) = delete;
+    shm_exporter_t(shm_exporter_t&&) = delete;
+    shm_exporter_t& operator=(const shm_exporter_t&) = delete;
+    shm_exporter_t& operator=(shm_exporter_t&&) = delete;
+
+    // the snapshot to fill, readers see it once published
+    shm_snapshot_t& begin_snapshot(std::size_t world, std::uint64_t tick);
+    void publish_snapshot(std::size_t world, std::uint64_t tick);
+
+private:
+    shm_world_t& world(std::size_t index);
+
+    std::string name_;
+    std::size_t size_;
+    void* data_;
+};
+
+} // sd
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sd {
+
+// Binary layout of the shared-memory export of the worlds, written by
+// shm_exporter_t and read by shm_reader_t. It only depends on the
+// standard library so that consumers can include it alone. Numbers are
+// in the byte order of the host.
+//
+// The segment holds a header followed by one ring of snapshots per
+// world. Each snapshot is guarded by a sequence number, odd while the
+// snapshot is written: readers copy the snapshot then check that the
+// sequence number did not change meanwhile.
+
+constexpr std::uint32_t shm_magic = 0x53444d53; // "SDMS"
+constexpr std::uint32_t shm_version = 1;
+// snapshots kept per world, a bit more than a second of ticks
+constexpr std::size_t shm_ring_size = 64;
+constexpr std::size_t shm_max_players = 16;
+constexpr std::size_t shm_name_size = 30;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+enum shm_player_flags_t : std::uint8_t {
+    shm_player_alive = 1U << 0U,
+    shm_player_fake = 1U << 1U,
+};
+
+struct shm_player_t {
+    std::array<std::uint8_t, 16> id; // NOLINT(*-magic-numbers)
+    // not null terminated
+    std::array<char, shm_name_size> name;
+    std::uint8_t name_size;
+    std::uint8_t flags;
+    double x;
+    double y;
+    double dx;
+    double dy;
+    double ddx;
+    double ddy;
+    double score;
+    double best_score;
+};
+static_assert(sizeof(shm_player_t) == 112);
+
+struct shm_snapshot_t {
+    std::uint64_t tick;
+    // system clock, nanoseconds since the epoch
+    std::int64_t time_ns;
+    std::uint32_t player_count;
+    std::uint32_t reserved;
+    std::array<shm_player_t, shm_max_players> players;
+};
+
+struct shm_slot_t {
+    std::atomic<std::uint64_t> sequence;
+    shm_snapshot_t snapshot;
+};
+
+struct alignas(64) shm_world_t {
+    // tick of the last snapshot published, 0 before the first one,
+    // the snapshot of tick t is in the slot t % shm_ring_size
+    std::atomic<std::uint64_t> latest_tick;
+    std::array<shm_slot_t, shm_ring_size> ring;
+};
+
+struct alignas(64) shm_header_t {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t world_count;
+    std::uint32_t ring_size;
+    std::uint32_t max_players;
+};
+
+constexpr std::size_t shm_segment_size(std::size_t world_count)
+{
+    return sizeof(shm_header_t) + world_count * sizeof(shm_world_t);
+}
+
+} // sd
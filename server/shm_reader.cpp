@@ -0,0 +1,101 @@
+#include "shm_reader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sd {
+
+namespace {
+
+// a writer holds a slot for a few hundred nanoseconds
+constexpr int max_read_attempts = 1000;
+
+[[noreturn]] void throw_errno(const char* what)
+{
+    throw std::system_error{errno, std::generic_category(), what};
+}
+
+}
+
+shm_reader_t::shm_reader_t(const std::string& name)
+{
+    const auto fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw_errno("shm_open");
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw_errno("fstat");
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+        throw_errno("mmap");
+    }
+
+    const auto* header = static_cast<const shm_header_t*>(data_);
+    if (size_ < sizeof(shm_header_t) || header->magic != shm_magic
+        || header->version != shm_version
+        || header->ring_size != shm_ring_size
+        || header->max_players != shm_max_players
+        || size_ < shm_segment_size(header->world_count)) {
+        ::munmap(const_cast<void*>(data_), size_);
+        throw std::runtime_error{"unexpected shared-memory layout"};
+    }
+}
+
+shm_reader_t::~shm_reader_t()
+{
+    ::munmap(const_cast<void*>(data_), size_);
+}
+
+std::size_t shm_reader_t::world_count() const
+{
+    return static_cast<const shm_header_t*>(data_)->world_count;
+}
+
+std::uint64_t shm_reader_t::latest_tick(std::size_t world) const
+{
+    return this->world(world).latest_tick.load(std::memory_order_acquire);
+}
+
+bool shm_reader_t::read(
+    std::size_t world,
+    std::uint64_t tick,
+    shm_snapshot_t& out) const
+{
+    const auto& slot = this->world(world).ring[tick % shm_ring_size];
+    for (int attempt = 0; attempt < max_read_attempts; ++attempt) {
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        if (before % 2 != 0) {
+            // being written
+            continue;
+        }
+        std::memcpy(&out, &slot.snapshot, sizeof(out));
+        // the copy completes before the sequence number is read again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const auto after = slot.sequence.load(std::memory_order_relaxed);
+        if (before == after) {
+            return out.tick == tick;
+        }
+    }
+    return false;
+}
+
+const shm_world_t& shm_reader_t::world(std::size_t index) const
+{
+    const auto* worlds = reinterpret_cast<const shm_world_t*>( // NOLINT
+        static_cast<const char*>(data_) + sizeof(shm_header_t));
+    return worlds[index];
+}
+
+} // sd
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "shm_layout.h"
+
+namespace sd {
+
+// Maps the shared-memory export of a server read-only, see
+// shm_layout.h. Reading never blocks the server: a snapshot overwritten
+// while it is copied is read again or reported as lost.
+class shm_reader_t {
+public:
+    // throws std::system_error if the segment can't be mapped,
+    // std::runtime_error if its layout is not the expected one
+    explicit shm_reader_t(const std::string& name);
+    ~shm_reader_t();
+
+    shm_reader_t(const shm_reader_t&) = delete;
+    shm_reader_t(shm_reader_t&&) = delete;
+    shm_reader_t& operator=(const shm_reader_t&) = delete;
+    shm_reader_t& operator=(shm_reader_t&&) = delete;
+
+    [[nodiscard]] std::size_t world_count() const;
+    // 0 before the first snapshot
+    [[nodiscard]] std::uint64_t latest_tick(std::size_t world) const;
+
+    // Copies the snapshot of a tick. Fails if it is not published yet,
+    // if it was overwritten by a more recent one or if the server
+    // stopped while writing it.
+    bool read(std::size_t world, std::uint64_t tick, shm_snapshot_t& out)
+        const;
+
+private:
+    const shm_world_t& world(std::size_t index) const;
+
+    std::size_t size_;
+    const void* data_;
+};
+
+} // sd
@@ -0,0 +1,305 @@
+// Headless capacity simulation: runs worlds on a virtual clock, as fast
+// as a single core allows. Simulated players join, play, leave and come
+// back, before or after their reservation expired, while bots fill the
+// empty places. The worlds and their timing wheel are stepped exactly as
+// they are in real time, only without waiting. Reports how many ticks
+// per second the core sustains, hence how many worlds it can run.
+// With $SIM_SHM_EXPORT, the worlds also export their snapshots, which
+// gives the cost of the shared-memory export on the ticks. With
+// $SIM_LOG_EVENTS set to drop or block, the player events go through
+// the event log with that overflow policy, to compare the cost of the
+// joins, the leaves and the ticks with and without logging.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <boost/uuid/random_generator.hpp>
+#include <spdlog/spdlog.h>
+
+#include "event_log.h"
+#include "latency_histogram.h"
+#include "player.h"
+#include "shm_exporter.h"
+#include "timing_wheel.h"
+#include "world.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto worlds_envvar = "SIM_WORLDS";
+// simulated seconds
+constexpr auto duration_envvar = "SIM_DURATION";
+constexpr auto players_envvar = "SIM_PLAYERS";
+// mean time spent playing and away, in simulated seconds
+constexpr auto session_envvar = "SIM_SESSION";
+constexpr auto away_envvar = "SIM_AWAY";
+constexpr auto shm_export_envvar = "SIM_SHM_EXPORT";
+constexpr auto log_events_envvar = "SIM_LOG_EVENTS";
+
+constexpr auto input_period = std::chrono::milliseconds{500};
+constexpr std::int64_t ticks_per_wheel_step =
+    timing_wheel_t::resolution / world_t::refresh_dt;
+constexpr std::int64_t ticks_per_input = input_period / world_t::refresh_dt;
+constexpr double ticks_per_second =
+    1. / std::chrono::duration<double>{world_t::refresh_dt}.count();
+
+long env_or(const char* name, long default_value)
+{
+    const auto* value = std::getenv(name);
+    return value ? std::atol(value) : default_value;
+}
+
+struct sim_player_t {
+    player_id_t id;
+    player_handle_t handle;
+    // leaves when playing, comes back when away
+    std::int64_t next_move_tick;
+};
+
+struct sim_stats_t {
+    std::int64_t joined{0};
+    std::int64_t restored{0};
+    std::int64_t rejected{0};
+    std::int64_t left{0};
+    std::int64_t respawns{0};
+};
+
+class simulation_t {
+public:
+    simulation_t(
+        long worlds,
+        long players,
+        long session,
+        long away,
+        const char* shm_export)
+        : session_ticks_{static_cast<double>(session) * ticks_per_second},
+          away_ticks_{static_cast<double>(away) * ticks_per_second}
+    {
+        if (shm_export != nullptr) {
+            exporter_ = std::make_unique<shm_exporter_t>(
+                shm_export, static_cast<std::size_t>(worlds));
+        }
+        for (long i = 0; i < worlds; ++i) {
+            worlds_.push_back(std::make_shared<world_t>(ioc_, wheel_));
+            if (exporter_) {
+                worlds_.back()->export_to(
+                    *exporter_, static_cast<std::size_t>(i));
+            }
+            auto& world_players = players_.emplace_back();
+            for (long j = 0; j < players; ++j) {
+                world_players.push_back(
+                    {uuid_generator_(), {}, random_ticks(away_ticks_ / 10)});
+            }
+        }
+    }
+
+    void step(std::int64_t tick)
+    {
+        for (std::size_t i = 0; i < worlds_.size(); ++i) {
+            for (auto& player : players_[i]) {
+                drive(*worlds_[i], player, tick);
+            }
+
+            const auto start = clock_t::now();
+            worlds_[i]->tick();
+            const auto elapsed = clock_t::now() - start;
+            tick_time_.record(elapsed);
+            tick_total_ += elapsed;
+            world_time_ += elapsed;
+        }
+
+        if (tick % ticks_per_wheel_step == 0) {
+            const auto start = clock_t::now();
+            wheel_.advance();
+            wheel_time_ += clock_t::now() - start;
+        }
+    }
+
+    [[nodiscard]] const sim_stats_t& stats() const { return stats_; }
+    [[nodiscard]] const latency_histogram_t& tick_time() const
+    {
+        return tick_time_;
+    }
+    // registrations and leaves, which log the player events
+    [[nodiscard]] const latency_histogram_t& event_time() const
+    {
+        return event_time_;
+    }
+    [[nodiscard]] std::chrono::nanoseconds mean_tick_time() const
+    {
+        return tick_total_ / std::max<std::int64_t>(tick_time_.count(), 1);
+    }
+    [[nodiscard]] std::chrono::nanoseconds mean_event_time() const
+    {
+        return event_total_ / std::max<std::int64_t>(event_time_.count(), 1);
+    }
+    // time spent in the worlds and the wheel, the driver excluded
+    [[nodiscard]] std::chrono::nanoseconds world_time() const
+    {
+        return world_time_ + wheel_time_;
+    }
+
+private:
+    using clock_t = std::chrono::steady_clock;
+
+    std::int64_t random_ticks(double mean)
+    {
+        std::exponential_distribution<double> dist{1. / mean};
+        return static_cast<std::int64_t>(dist(rnd_gen_)) + 1;
+    }
+
+    void drive(world_t& world, sim_player_t& player, std::int64_t tick)
+    {
+        if (player.handle && tick % ticks_per_input == 0) {
+            if (!player.handle->alive()) {
+                player.handle->input().request_respawn();
+                ++stats_.respawns;
+            }
+            std::uniform_real_distribution<double> dd{
+                -player_t::max_dd, player_t::max_dd};
+            player.handle->input().write_dd(dd(rnd_gen_), dd(rnd_gen_));
+        }
+
+        if (tick < player.next_move_tick) {
+            return;
+        }
+        if (player.handle) {
+            const auto start = clock_t::now();
+            player.handle.reset();
+            record_event_time(clock_t::now() - start);
+            ++stats_.left;
+            player.next_move_tick = tick + random_ticks(away_ticks_);
+            return;
+        }
+
+        const auto reserved = world.has_reservation(player.id);
+        const auto start = clock_t::now();
+        try {
+            player.handle = world.register_player(player.id, "simulated");
+            record_event_time(clock_t::now() - start);
+            if (reserved) {
+                ++stats_.restored;
+            }
+            else {
+                ++stats_.joined;
+            }
+            player.next_move_tick = tick + random_ticks(session_ticks_);
+        }
+        catch (const world_full&) {
+            record_event_time(clock_t::now() - start);
+            ++stats_.rejected;
+            player.next_move_tick = tick + random_ticks(away_ticks_);
+        }
+    }
+
+    void record_event_time(std::chrono::nanoseconds elapsed)
+    {
+        event_time_.record(elapsed);
+        event_total_ += elapsed;
+        world_time_ += elapsed;
+    }
+
+    const double session_ticks_;
+    const double away_ticks_;
+    // never run, the worlds are stepped by the simulation
+    net::io_context ioc_{1};
+    timing_wheel_t wheel_;
+    std::unique_ptr<shm_exporter_t> exporter_;
+    std::vector<std::shared_ptr<world_t>> worlds_;
+    std::vector<std::vector<sim_player_t>> players_;
+    std::mt19937 rnd_gen_{std::random_device{}()};
+    boost::uuids::random_generator uuid_generator_;
+    sim_stats_t stats_;
+    latency_histogram_t tick_time_;
+    latency_histogram_t event_time_;
+    std::chrono::nanoseconds tick_total_{0};
+    std::chrono::nanoseconds event_total_{0};
+    std::chrono::nanoseconds world_time_{0};
+    std::chrono::nanoseconds wheel_time_{0};
+};
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto nworlds = env_or(worlds_envvar, 16);
+    const auto duration = std::chrono::seconds{env_or(duration_envvar, 3600)};
+    const auto players =
+        env_or(players_envvar, static_cast<long>(world_t::max_players / 2));
+    const auto session = env_or(session_envvar, 120);
+    const auto away = env_or(away_envvar, 240);
+
+    const auto* shm_export = std::getenv(shm_export_envvar);
+    const auto* log_events = std::getenv(log_events_envvar);
+    if (log_events != nullptr) {
+        start_event_log(
+            {.overflow_policy = std::string_view{log_events} == "block"
+                                    ? overflow_policy_t::block
+                                    : overflow_policy_t::drop});
+    }
+
+    simulation_t simulation{nworlds, players, session, away, shm_export};
+    const std::int64_t ticks = duration / world_t::refresh_dt;
+
+    spdlog::info(
+        "simulating {} worlds of {} players for {}s ({} ticks){}",
+        nworlds,
+        players,
+        duration.count(),
+        ticks,
+        shm_export ? ", exporting to shared memory" : "");
+    const auto start = std::chrono::steady_clock::now();
+    for (std::int64_t tick = 1; tick <= ticks; ++tick) {
+        simulation.step(tick);
+    }
+    const std::chrono::duration<double> wall =
+        std::chrono::steady_clock::now() - start;
+
+    const std::chrono::duration<double> world_time = simulation.world_time();
+    const auto world_ticks = static_cast<double>(ticks * nworlds);
+    const auto ticks_per_core_second = world_ticks / world_time.count();
+    const auto& stats = simulation.stats();
+    const auto& tick_time = simulation.tick_time();
+
+    spdlog::info(
+        "wall time {:.1f}s, {:.0f}x real time, {:.1f}s in the worlds",
+        wall.count(),
+        static_cast<double>(duration.count()) / wall.count(),
+        world_time.count());
+    spdlog::info(
+        "players: {} joined, {} restored, {} rejected, {} left, {} respawns",
+        stats.joined,
+        stats.restored,
+        stats.rejected,
+        stats.left,
+        stats.respawns);
+    spdlog::info(
+        "tick time: avg {}ns, p50 {}us, p99 {}us, max {}us",
+        simulation.mean_tick_time().count(),
+        tick_time.percentile(0.5).count(), // NOLINT(*-magic-numbers)
+        tick_time.percentile(0.99).count(), // NOLINT(*-magic-numbers)
+        tick_time.max().count());
+    const auto& event_time = simulation.event_time();
+    spdlog::info(
+        "joins and leaves: avg {}ns, p50 {}us, p99 {}us, max {}us, {} "
+        "logged",
+        simulation.mean_event_time().count(),
+        event_time.percentile(0.5).count(), // NOLINT(*-magic-numbers)
+        event_time.percentile(0.99).count(), // NOLINT(*-magic-numbers)
+        event_time.max().count(),
+        log_events ? log_events : "not");
+    spdlog::info(
+        "{:.0f} world ticks per second, {:.0f} worlds per core at {:.0f} "
+        "ticks/s",
+        ticks_per_core_second,
+        ticks_per_core_second / ticks_per_second,
+        ticks_per_second);
+    stop_event_log();
+    return EXIT_SUCCESS;
+}
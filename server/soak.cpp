@@ -0,0 +1,336 @@
+// Connection churn soak test: runs the server in-process and hammers it
+// with clients that connect, register, play and disconnect in a loop,
+// reusing player ids or generating fresh ones. Process stats are sampled
+// over time and the run fails if memory or file descriptors keep growing
+// once the server reached its steady state, or if sessions or players
+// leak. The steady state starts once the warmup is over and the first
+// reservations expire, the run should last well beyond it.
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "event_log.h"
+#include "listener.h"
+#include "process_stats.h"
+#include "timing_wheel.h"
+#include "world.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto duration_envvar = "SOAK_DURATION";
+constexpr auto clients_envvar = "SOAK_CLIENTS";
+constexpr auto sample_period_envvar = "SOAK_SAMPLE_PERIOD";
+constexpr auto max_growth_envvar = "SOAK_MAX_GROWTH";
+constexpr auto nworlds_envvar = "NWORLDS";
+
+// the first part of the run is not checked, the server needs some time
+// to reach its steady state, then the reservations of the players who
+// left pile up for world_t::idle_duration
+constexpr double warmup_ratio = 0.25;
+constexpr double reuse_id_probability = 0.5;
+constexpr double clean_close_probability = 0.5;
+constexpr int min_frames = 5;
+constexpr int max_frames = 150;
+constexpr auto retry_delay = std::chrono::milliseconds{100};
+constexpr auto drain_delay = std::chrono::seconds{2};
+constexpr std::int64_t fd_slack = 2;
+constexpr std::size_t max_known_ids = 256;
+
+long env_or(const char* name, long default_value)
+{
+    const auto* value = std::getenv(name);
+    return value ? std::atol(value) : default_value;
+}
+
+struct sample_t {
+    double t;
+    process_stats_t stats;
+};
+
+struct soak_state_t {
+    bool stopping{false};
+    int active_clients{0};
+    std::int64_t cycles{0};
+    std::int64_t failures{0};
+    std::vector<std::string> known_ids;
+    boost::uuids::random_generator uuid_generator;
+    std::mt19937 rnd_gen{std::random_device{}()};
+};
+
+// least squares slope of a stat, per second
+template <typename Proj>
+double slope(const std::vector<sample_t>& samples, Proj proj)
+{
+    const auto n = static_cast<double>(samples.size());
+    double st = 0;
+    double sv = 0;
+    double stt = 0;
+    double stv = 0;
+    for (const auto& s : samples) {
+        const auto v = static_cast<double>(proj(s.stats));
+        st += s.t;
+        sv += v;
+        stt += s.t * s.t;
+        stv += s.t * v;
+    }
+    const auto denom = n * stt - st * st;
+    return denom == 0 ? 0 : (n * stv - st * sv) / denom;
+}
+
+std::string pick_player_id(soak_state_t& state)
+{
+    std::bernoulli_distribution reuse{reuse_id_probability};
+    if (!state.known_ids.empty() && reuse(state.rnd_gen)) {
+        std::uniform_int_distribution<std::size_t> idx{
+            0, state.known_ids.size() - 1};
+        return state.known_ids[idx(state.rnd_gen)];
+    }
+    auto id = to_string(state.uuid_generator());
+    if (state.known_ids.size() < max_known_ids) {
+        state.known_ids.push_back(id);
+    }
+    else {
+        // bounded so that the harness itself does not grow
+        std::uniform_int_distribution<std::size_t> idx{0, max_known_ids - 1};
+        state.known_ids[idx(state.rnd_gen)] = id;
+    }
+    return id;
+}
+
+net::awaitable<void> play_once(const tcp::endpoint& endpoint, soak_state_t& state)
+{
+    auto executor = co_await net::this_coro::executor;
+    websocket::stream<beast::tcp_stream> ws{executor};
+
+    co_await beast::get_lowest_layer(ws).async_connect(
+        endpoint, net::use_awaitable);
+    ws.set_option(
+        websocket::stream_base::timeout::suggested(beast::role_type::client));
+    co_await ws.async_handshake(
+        endpoint.address().to_string(), "/", net::use_awaitable);
+
+    const auto registration = nlohmann::json{
+        {"command",
+         {{"register", {{"id", pick_player_id(state)}, {"name", "soak"}}}}}}
+                                  .dump();
+    co_await ws.async_write(net::buffer(registration), net::use_awaitable);
+
+    std::uniform_int_distribution<int> frames_dist{min_frames, max_frames};
+    std::uniform_real_distribution<double> dd_dist{-1, 1};
+    const auto frames = frames_dist(state.rnd_gen);
+    beast::flat_buffer buffer;
+    for (int i = 0; i < frames && !state.stopping; ++i) {
+        co_await ws.async_read(buffer, net::use_awaitable);
+        buffer.consume(buffer.size());
+
+        const auto input = nlohmann::json{
+            {"input",
+             {{"ddx", dd_dist(state.rnd_gen)},
+              {"ddy", dd_dist(state.rnd_gen)}}}}
+                               .dump();
+        co_await ws.async_write(net::buffer(input), net::use_awaitable);
+    }
+
+    if (std::bernoulli_distribution{clean_close_probability}(state.rnd_gen)) {
+        co_await ws.async_close(
+            websocket::close_code::normal, net::use_awaitable);
+    }
+    else {
+        beast::get_lowest_layer(ws).close();
+    }
+}
+
+net::awaitable<void> client_loop(tcp::endpoint endpoint, soak_state_t& state)
+{
+    auto executor = co_await net::this_coro::executor;
+    net::steady_timer timer{executor};
+
+    ++state.active_clients;
+    while (!state.stopping) {
+        bool failed = false;
+        try {
+            co_await play_once(endpoint, state);
+            ++state.cycles;
+        }
+        catch (const std::exception&) {
+            // rejected because all worlds are full, or
+            // because the player id is already in use
+            ++state.failures;
+            failed = true;
+        }
+        if (failed) {
+            timer.expires_after(retry_delay);
+            co_await timer.async_wait(net::use_awaitable);
+        }
+    }
+    --state.active_clients;
+}
+
+void log_sample(const sample_t& s, const soak_state_t& state)
+{
+    constexpr double kib = 1024.;
+    spdlog::info(
+        "t={:.0f}s rss={:.0f}KiB heap={:.0f}KiB fds={} sessions={} "
+        "players={} cycles={} failures={}",
+        s.t,
+        static_cast<double>(s.stats.rss_bytes) / kib,
+        static_cast<double>(s.stats.heap_bytes) / kib,
+        s.stats.open_fds,
+        s.stats.sessions,
+        s.stats.players,
+        state.cycles,
+        state.failures);
+}
+
+net::awaitable<bool> run_soak(tcp::endpoint endpoint, soak_state_t& state)
+{
+    const auto duration = std::chrono::seconds{env_or(duration_envvar, 600)};
+    const auto sample_period =
+        std::chrono::seconds{env_or(sample_period_envvar, 5)};
+    const auto nclients = env_or(clients_envvar, 32);
+    const auto max_growth_per_minute =
+        static_cast<double>(env_or(max_growth_envvar, 256 * 1024));
+
+    auto executor = co_await net::this_coro::executor;
+    net::steady_timer timer{executor};
+    const auto baseline = sample_process_stats();
+
+    for (long i = 0; i < nclients; ++i) {
+        net::co_spawn(executor, client_loop(endpoint, state), net::detached);
+    }
+
+    std::vector<sample_t> samples;
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < duration) {
+        timer.expires_after(sample_period);
+        co_await timer.async_wait(net::use_awaitable);
+
+        const auto t = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        samples.push_back({t, sample_process_stats()});
+        log_sample(samples.back(), state);
+    }
+
+    // stop the clients and let the sessions end
+    state.stopping = true;
+    while (state.active_clients > 0) {
+        timer.expires_after(retry_delay);
+        co_await timer.async_wait(net::use_awaitable);
+    }
+    timer.expires_after(drain_delay);
+    co_await timer.async_wait(net::use_awaitable);
+    const auto final_stats = sample_process_stats();
+
+    // the run is over, instead of waiting for the reservations to
+    // expire in real time
+    auto& timing_wheel = timing_wheel_t::of(executor);
+    for (auto i = 0; i <= world_t::idle_duration / timing_wheel_t::resolution;
+         ++i) {
+        timing_wheel.advance();
+    }
+    const auto expired_stats = sample_process_stats();
+
+    const auto steady_start =
+        warmup_ratio * std::chrono::duration<double>{duration}.count()
+        + std::chrono::duration<double>{world_t::idle_duration}.count();
+    const auto steady_begin =
+        std::find_if(samples.begin(), samples.end(), [&](const auto& s) {
+            return s.t >= steady_start;
+        });
+    const std::vector<sample_t> steady{steady_begin, samples.end()};
+    constexpr double seconds_per_minute = 60;
+    const auto heap_growth =
+        slope(steady, [](const auto& s) { return s.heap_bytes; })
+        * seconds_per_minute;
+    const auto rss_growth =
+        slope(steady, [](const auto& s) { return s.rss_bytes; })
+        * seconds_per_minute;
+
+    bool success = true;
+    const auto check = [&](bool ok, const std::string& what) {
+        spdlog::log(
+            ok ? spdlog::level::info : spdlog::level::err,
+            "{}: {}",
+            ok ? "PASS" : "FAIL",
+            what);
+        success = success && ok;
+    };
+
+    check(state.cycles > 0, fmt::format("{} completed cycles", state.cycles));
+    check(
+        steady.size() >= 2,
+        fmt::format("{} samples after warmup", steady.size()));
+    check(
+        heap_growth <= max_growth_per_minute,
+        fmt::format("heap growth {:.0f} B/min", heap_growth));
+    check(
+        rss_growth <= max_growth_per_minute,
+        fmt::format("rss growth {:.0f} B/min", rss_growth));
+    check(
+        final_stats.open_fds <= baseline.open_fds + fd_slack,
+        fmt::format(
+            "{} open fds, {} before the run",
+            final_stats.open_fds,
+            baseline.open_fds));
+    check(
+        final_stats.sessions == 0,
+        fmt::format("{} live sessions", final_stats.sessions));
+    // fake players are removed when there is no more active player in
+    // a world, idle players once their reservation expired
+    check(
+        expired_stats.players == 0,
+        fmt::format(
+            "{} live players once the reservations expired, {} before",
+            expired_stats.players,
+            final_stats.players));
+
+    co_return success;
+}
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto nworlds = static_cast<std::size_t>(env_or(nworlds_envvar, 4));
+
+    start_event_log({.player_events = false});
+
+    net::io_context ioc{1};
+
+    std::vector<std::shared_ptr<world_t>> worlds;
+    for (std::size_t i = 0; i < nworlds; ++i) {
+        worlds.emplace_back(std::make_shared<world_t>(ioc));
+        worlds.back()->run();
+    }
+    auto listener = std::make_shared<listener_t>(
+        ioc,
+        std::move(worlds),
+        tcp::endpoint{net::ip::make_address("127.0.0.1"), 0});
+    listener->run();
+
+    soak_state_t state;
+    bool success = false;
+    net::co_spawn(
+        ioc,
+        run_soak(listener->local_endpoint(), state),
+        [&](const std::exception_ptr& exc, bool result) {
+            success = !exc && result;
+            ioc.stop();
+        });
+
+    ioc.run();
+    stop_event_log();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
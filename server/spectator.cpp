@@ -0,0 +1,146 @@
+#include "spectator.h"
+#include "world.h"
+
+#include <spdlog/spdlog.h>
+
+#include <unistd.h>
+
+namespace sd {
+
+namespace {
+
+constexpr auto max_world_index_length = 16;
+
+// Forwards the frames of a world to a relay. Only the latest frame
+// is kept while a write is in progress, a slow relay skips frames
+// instead of slowing down the world.
+class spectator_feed_t : public spectator_t,
+                         public std::enable_shared_from_this<spectator_feed_t> {
+public:
+    explicit spectator_feed_t(local_stream::socket&& socket)
+        : socket_{std::move(socket)}, wakeup_{socket_.get_executor()}
+    {
+    }
+
+    void on_frame(const frame_t& frame) override
+    {
+        pending_ = frame;
+        wakeup_.cancel();
+    }
+
+    net::awaitable<void> write_loop()
+    {
+        while (socket_.is_open()) {
+            if (!pending_) {
+                boost::system::error_code ec;
+                wakeup_.expires_at(net::steady_timer::time_point::max());
+                co_await wakeup_.async_wait(
+                    net::redirect_error(net::use_awaitable, ec));
+                continue;
+            }
+
+            const auto frame = std::move(pending_);
+            pending_.reset();
+            const auto header = encode_frame_header(frame->size());
+            const std::array buffers{
+                net::buffer(header),
+                net::buffer(*frame),
+            };
+            co_await net::async_write(socket_, buffers, net::use_awaitable);
+        }
+    }
+
+private:
+    local_stream::socket socket_;
+    net::steady_timer wakeup_;
+    frame_t pending_;
+};
+
+}
+
+frame_header_t encode_frame_header(std::size_t size)
+{
+    return {
+        static_cast<unsigned char>(size >> 24), // NOLINT(*-magic-numbers)
+        static_cast<unsigned char>(size >> 16), // NOLINT(*-magic-numbers)
+        static_cast<unsigned char>(size >> 8), // NOLINT(*-magic-numbers)
+        static_cast<unsigned char>(size),
+    };
+}
+
+std::size_t decode_frame_header(const frame_header_t& header)
+{
+    return (std::size_t{header[0]} << 24) // NOLINT(*-magic-numbers)
+           | (std::size_t{header[1]} << 16) // NOLINT(*-magic-numbers)
+           | (std::size_t{header[2]} << 8) // NOLINT(*-magic-numbers)
+           | std::size_t{header[3]};
+}
+
+spectator_listener_t::spectator_listener_t(
+    net::io_context& ioc,
+    std::vector<std::shared_ptr<world_t>> worlds,
+    const std::string& path)
+    : ioc_{ioc}, acceptor_{ioc}, worlds_{std::move(worlds)}
+{
+    // remove the socket left by a previous run
+    ::unlink(path.c_str());
+
+    const local_stream::endpoint endpoint{path};
+    acceptor_.open(endpoint.protocol());
+    acceptor_.bind(endpoint);
+    acceptor_.listen(net::socket_base::max_listen_connections);
+}
+
+void spectator_listener_t::run()
+{
+    net::co_spawn(
+        ioc_,
+        [self = shared_from_this()]() -> net::awaitable<void> {
+            co_await self->on_run();
+        },
+        net::detached);
+}
+
+net::awaitable<void> spectator_listener_t::on_run()
+{
+    spdlog::info(
+        "serving spectator feeds on {}", acceptor_.local_endpoint().path());
+
+    while (true) {
+        auto socket = co_await acceptor_.async_accept(net::use_awaitable);
+        net::co_spawn(
+            ioc_,
+            [self = shared_from_this(),
+             socket = std::move(socket)]() mutable -> net::awaitable<void> {
+                co_await self->serve(std::move(socket));
+            },
+            net::detached);
+    }
+}
+
+net::awaitable<void> spectator_listener_t::serve(local_stream::socket socket)
+{
+    std::string line;
+    co_await net::async_read_until(
+        socket,
+        net::dynamic_buffer(line, max_world_index_length),
+        '\n',
+        net::use_awaitable);
+
+    const auto idx = std::atoi(line.c_str());
+    if (idx < 0 || static_cast<std::size_t>(idx) >= worlds_.size()) {
+        spdlog::warn("spectator requested unknown world {}", idx);
+        co_return;
+    }
+
+    auto feed = std::make_shared<spectator_feed_t>(std::move(socket));
+    worlds_[static_cast<std::size_t>(idx)]->add_spectator(feed);
+    try {
+        co_await feed->write_loop();
+    }
+    catch (const boost::system::system_error&) {
+        // relay disconnected, the world forgets expired spectators
+    }
+}
+
+} // sd
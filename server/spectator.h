@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+namespace sd {
+
+// Spectator feeds are served over a local socket, to a relay
+// that forwards them to the viewers. The relay writes the index
+// of the world followed by a newline, the server then streams
+// the frames of this world, each one prefixed by its size as a
+// 4 bytes big-endian integer.
+using frame_header_t = std::array<unsigned char, 4>;
+
+frame_header_t encode_frame_header(std::size_t size);
+std::size_t decode_frame_header(const frame_header_t& header);
+
+class spectator_listener_t
+    : public std::enable_shared_from_this<spectator_listener_t> {
+public:
+    spectator_listener_t(
+        net::io_context& ioc,
+        std::vector<std::shared_ptr<world_t>> worlds,
+        const std::string& path);
+
+    void run();
+
+private:
+    net::awaitable<void> on_run();
+    net::awaitable<void> serve(local_stream::socket socket);
+
+    net::io_context& ioc_;
+    local_stream::acceptor acceptor_;
+    std::vector<std::shared_ptr<world_t>> worlds_;
+};
+
+} // sd
@@ -0,0 +1,148 @@
+#include "state_writer.h"
+#include "player.h"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+
+#include <nlohmann/json.hpp>
+
+namespace sd {
+
+void write_json_number(std::string& out, double value)
+{
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    // the Grisu2 implementation of nlohmann::json::dump(),
+    // it writes in place without allocating
+    std::array<char, 64> buffer{}; // NOLINT(*-magic-numbers)
+    auto* end = nlohmann::detail::to_chars(
+        buffer.data(), buffer.data() + buffer.size(), value);
+    out.append(buffer.data(), static_cast<std::size_t>(end - buffer.data()));
+}
+
+void write_json_string(std::string& out, std::string_view value)
+{
+    static constexpr std::string_view hex = "0123456789abcdef";
+
+    out += '"';
+    for (const char c : value) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default: {
+            const auto code = static_cast<unsigned char>(c);
+            if (code < 0x20) { // NOLINT(*-magic-numbers)
+                out += "\\u00";
+                out += hex[code >> 4];   // NOLINT(*-magic-numbers)
+                out += hex[code & 0xf]; // NOLINT(*-magic-numbers)
+            }
+            else {
+                // UTF-8 is written as is
+                out += c;
+            }
+        }
+        }
+    }
+    out += '"';
+}
+
+state_writer_t::state_writer_t(std::size_t slots) : name_fragments_(slots) {}
+
+void state_writer_t::begin(bool game_over)
+{
+    buffer_.clear();
+    buffer_ += game_over ? R"({"game_over":true,"players":[)"
+                         : R"({"game_over":false,"players":[)";
+    first_player_ = true;
+}
+
+void state_writer_t::add_player(
+    std::size_t slot,
+    const player_t& player,
+    bool is_me)
+{
+    const auto bool_value = [](bool v) { return v ? "true" : "false"; };
+    const auto& state = player.state();
+
+    if (!first_player_) {
+        buffer_ += ',';
+    }
+    first_player_ = false;
+
+    buffer_ += R"({"alive":)";
+    buffer_ += bool_value(player.alive());
+    buffer_ += R"(,"best_score":)";
+    write_json_number(buffer_, player.best_score());
+    buffer_ += R"(,"ddx":)";
+    write_json_number(buffer_, state.ddx);
+    buffer_ += R"(,"ddy":)";
+    write_json_number(buffer_, state.ddy);
+    buffer_ += R"(,"dx":)";
+    write_json_number(buffer_, state.dx);
+    buffer_ += R"(,"dy":)";
+    write_json_number(buffer_, state.dy);
+    buffer_ += R"(,"fake":)";
+    buffer_ += bool_value(player.fake());
+    buffer_ += R"(,"is_me":)";
+    buffer_ += bool_value(is_me);
+    buffer_ += name_fragment(slot, player);
+    buffer_ += R"("score":)";
+    write_json_number(buffer_, player.score());
+    buffer_ += R"(,"size":)";
+    write_json_number(buffer_, player_t::state_t::size);
+    buffer_ += R"(,"x":)";
+    write_json_number(buffer_, state.x);
+    buffer_ += R"(,"y":)";
+    write_json_number(buffer_, state.y);
+    buffer_ += '}';
+}
+
+std::string_view state_writer_t::end(std::uint64_t tick)
+{
+    buffer_ += R"(],"tick":)";
+    std::array<char, 24> digits{}; // NOLINT(*-magic-numbers)
+    auto* digits_end =
+        std::to_chars(digits.data(), digits.data() + digits.size(), tick).ptr;
+    buffer_.append(
+        digits.data(), static_cast<std::size_t>(digits_end - digits.data()));
+    buffer_ += '}';
+    return buffer_;
+}
+
+const std::string& state_writer_t::name_fragment(
+    std::size_t slot,
+    const player_t& player)
+{
+    auto& cached = name_fragments_[slot];
+    if (cached.fragment.empty() || cached.player_id != player.id()) {
+        cached.player_id = player.id();
+        cached.fragment = R"(,"name":)";
+        write_json_string(cached.fragment, player.name());
+        cached.fragment += ',';
+    }
+    return cached.fragment;
+}
+
+} // sd
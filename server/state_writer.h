@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+
+namespace sd {
+
+// Writes the game state messages without building a JSON document.
+// The output is the one of nlohmann::json::dump() byte for byte: keys
+// in alphabetical order and the same number formatting. The buffer is
+// reused from one message to the next and the escaped names are cached.
+class state_writer_t {
+public:
+    // players are identified by their slot in the world
+    explicit state_writer_t(std::size_t slots);
+
+    void begin(bool game_over);
+    void add_player(std::size_t slot, const player_t& player, bool is_me);
+    // valid until the next call to begin
+    std::string_view end(std::uint64_t tick);
+
+private:
+    struct name_fragment_t {
+        player_id_t player_id;
+        std::string fragment;
+    };
+
+    const std::string& name_fragment(std::size_t slot, const player_t& player);
+
+    std::string buffer_;
+    bool first_player_{true};
+    // "name":"...", escaped once per player
+    std::vector<name_fragment_t> name_fragments_;
+};
+
+// Append values as nlohmann::json::dump() does: Grisu2 digits with a
+// ".0" suffix for integers and null for NaN and infinity, strings
+// escaped with lowercase \u00XX sequences and UTF-8 left as is.
+void write_json_number(std::string& out, double value);
+void write_json_string(std::string& out, std::string_view value);
+
+} // sd
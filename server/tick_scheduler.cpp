@@ -0,0 +1,172 @@
+#include "tick_scheduler.h"
+#include "event_log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace sd {
+
+namespace {
+
+constexpr auto load_stats_period = std::chrono::minutes{1};
+constexpr std::int64_t periods_per_report =
+    load_stats_period / tick_scheduler_t::period;
+// weight of the last period in the smoothed load, about the last
+// second counts
+constexpr double load_smoothing = 1. / 64;
+
+// Owns the tick scheduler of an io_context
+class tick_scheduler_service_t : public net::io_context::service {
+public:
+    static net::execution_context::id id;
+
+    explicit tick_scheduler_service_t(net::io_context& ioc)
+        : service{ioc}, scheduler_{ioc}
+    {
+    }
+
+    tick_scheduler_t& scheduler() { return scheduler_; }
+
+private:
+    void shutdown() override
+    {
+        // the worlds go before the other services they depend on
+        scheduler_.clear();
+    }
+
+    tick_scheduler_t scheduler_;
+};
+
+net::execution_context::id tick_scheduler_service_t::id;
+
+}
+
+tick_scheduler_t::tick_scheduler_t(net::io_context& ioc) : timer_{ioc} {}
+
+tick_scheduler_t& tick_scheduler_t::of(const net::any_io_executor& executor)
+{
+    // all the executors of the server are the ones of its io_context
+    auto& context = net::query(executor, net::execution::context);
+    return net::use_service<tick_scheduler_service_t>(
+               static_cast<net::io_context&>(context))
+        .scheduler();
+}
+
+void tick_scheduler_t::add(
+    std::function<void()> tick,
+    clock_t::duration expected_cost)
+{
+    const auto measured = size() - added_ticks_ - unmeasured_ticks_;
+    if (measured > 0) {
+        const auto mean_cost = std::chrono::duration_cast<clock_t::duration>(
+            std::max(load_, last_period_load_) * period
+            / static_cast<double>(measured));
+        expected_cost = std::max(expected_cost, mean_cost);
+    }
+    if (load() + std::chrono::duration<double>{expected_cost} / period
+        > max_load) {
+        throw tick_period_saturated{};
+    }
+    added_cost_ += expected_cost;
+    ++added_ticks_;
+
+    const bool was_empty = size() == 0;
+    auto batch_it = min_element(
+        begin(batches_), end(batches_), [](const auto& a, const auto& b) {
+            return a.size() < b.size();
+        });
+    batch_it->push_back(std::move(tick));
+    if (was_empty) {
+        start_ = clock_t::now();
+        next_phase_ = static_cast<std::uint64_t>(batch_it - begin(batches_));
+        arm();
+    }
+}
+
+void tick_scheduler_t::clear()
+{
+    timer_.cancel();
+    for (auto& batch : batches_) {
+        batch.clear();
+    }
+}
+
+double tick_scheduler_t::load() const
+{
+    return std::max(load_, last_period_load_)
+           + std::chrono::duration<double>{added_cost_ + unmeasured_cost_}
+                 / period;
+}
+
+std::size_t tick_scheduler_t::size() const
+{
+    return std::accumulate(
+        begin(batches_),
+        end(batches_),
+        std::size_t{0},
+        [](std::size_t n, const auto& batch) { return n + batch.size(); });
+}
+
+void tick_scheduler_t::arm()
+{
+    // late batches run right away, one after the other, until caught up
+    timer_.expires_at(
+        start_ + static_cast<std::int64_t>(next_phase_) * phase_duration);
+    timer_.async_wait(
+        [this](const boost::system::error_code& ec) { on_timer(ec); });
+}
+
+void tick_scheduler_t::on_timer(const boost::system::error_code& ec)
+{
+    if (ec) {
+        return;
+    }
+
+    const auto batch_start = clock_t::now();
+    if (batch_start - timer_.expiry() > phase_duration) {
+        ++late_batches_;
+    }
+    {
+        SD_TRACE_SCOPE("tick_scheduler_t::batch");
+        for (auto& tick : batches_[next_phase_ % phases]) {
+            tick();
+        }
+    }
+    busy_ += clock_t::now() - batch_start;
+
+    // at least one batch is not empty, at most one period ends
+    do {
+        if (++next_phase_ % phases == 0) {
+            end_period();
+        }
+    } while (batches_[next_phase_ % phases].empty());
+    arm();
+}
+
+void tick_scheduler_t::end_period()
+{
+    const auto period_load = std::chrono::duration<double>{busy_}
+                             / std::chrono::duration<double>{period};
+    busy_ = {};
+    load_ += (period_load - load_) * load_smoothing;
+    last_period_load_ = period_load;
+    unmeasured_cost_ = std::exchange(added_cost_, {});
+    unmeasured_ticks_ = std::exchange(added_ticks_, 0);
+
+    total_load_ += period_load;
+    max_period_load_ = std::max(max_period_load_, period_load);
+    if (++periods_ == periods_per_report) {
+        log_tick_load_stats(
+            static_cast<std::int64_t>(size()),
+            total_load_ / static_cast<double>(periods_),
+            max_period_load_,
+            late_batches_);
+        periods_ = 0;
+        total_load_ = max_period_load_ = 0;
+        late_batches_ = 0;
+    }
+}
+
+} // sd
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include "config.h"
+
+namespace sd {
+
+class tick_period_saturated : public std::runtime_error {
+public:
+    tick_period_saturated() : runtime_error{"tick period saturated"} {}
+};
+
+// Runs the periodic ticks of the worlds of an io_context from a single
+// timer. The period is split into phases, each world ticks in the phase
+// with the fewest worlds and the worlds of a phase tick as one batch.
+// The ticks are spread over the period instead of all landing at the
+// same instant, followed by idle time.
+class tick_scheduler_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    static constexpr auto period = std::chrono::milliseconds{20};
+    static constexpr std::size_t phases = 10;
+    static constexpr auto phase_duration = period / phases;
+    // fraction of the period spent ticking beyond which no tick is added
+    static constexpr double max_load = 0.8;
+
+    explicit tick_scheduler_t(net::io_context& ioc);
+
+    tick_scheduler_t(const tick_scheduler_t&) = delete;
+    tick_scheduler_t(tick_scheduler_t&&) = delete;
+    tick_scheduler_t& operator=(const tick_scheduler_t&) = delete;
+    tick_scheduler_t& operator=(tick_scheduler_t&&) = delete;
+
+    // the scheduler of the io_context running the executor, only used
+    // from the thread running it
+    static tick_scheduler_t& of(const net::any_io_executor& executor);
+
+    // Runs the tick once per period, at the latest from the next period
+    // on. Not to be called from a tick. Until the tick is measured, it
+    // counts in the load for the larger of expected_cost and the mean
+    // cost of the ticks already measured. Throws tick_period_saturated
+    // if the load would exceed max_load.
+    void add(std::function<void()> tick, clock_t::duration expected_cost);
+    void clear();
+    // time spent outside of the ticks on their behalf, counted in the
+    // load of the current period
+    void add_busy(clock_t::duration busy) { busy_ += busy; }
+
+    [[nodiscard]] std::size_t size() const;
+    // fraction of the period spent ticking: the larger of the last period
+    // and the smoothed load of the last periods, plus the expected cost
+    // of the ticks not measured yet
+    [[nodiscard]] double load() const;
+    [[nodiscard]] bool saturated() const { return load() > max_load; }
+
+private:
+    void arm();
+    void on_timer(const boost::system::error_code& ec);
+    void end_period();
+
+    net::steady_timer timer_;
+    clock_t::time_point start_;
+    std::array<std::vector<std::function<void()>>, phases> batches_;
+    // phases since start_, the next one to run
+    std::uint64_t next_phase_{0};
+    clock_t::duration busy_{0};
+    double load_{0};
+    double last_period_load_{0};
+    // expected costs of the ticks added during the current period and
+    // during the previous one, the next period measures them all
+    clock_t::duration added_cost_{0};
+    clock_t::duration unmeasured_cost_{0};
+    std::size_t added_ticks_{0};
+    std::size_t unmeasured_ticks_{0};
+
+    // since the last report
+    std::int64_t periods_{0};
+    double total_load_{0};
+    double max_period_load_{0};
+    std::int64_t late_batches_{0};
+};
+
+} // sd
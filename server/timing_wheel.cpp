@@ -0,0 +1,160 @@
+#include "timing_wheel.h"
+
+#include <algorithm>
+
+namespace sd {
+
+namespace {
+
+// Advances the wheel of an io_context in real time
+class timing_wheel_service_t : public net::io_context::service {
+public:
+    static net::execution_context::id id;
+
+    explicit timing_wheel_service_t(net::io_context& ioc)
+        : service{ioc}, timer_{ioc}, start_{clock_t::now()}
+    {
+        // always armed, so that scheduling never starts an operation
+        arm();
+    }
+
+    timing_wheel_t& wheel() { return wheel_; }
+
+private:
+    using clock_t = timing_wheel_t::clock_t;
+
+    void shutdown() override
+    {
+        // the pending wait is destroyed with the timer
+    }
+
+    void arm()
+    {
+        timer_.expires_at(
+            start_ + (wheel_.now() + 1) * timing_wheel_t::resolution);
+        timer_.async_wait(
+            [this](const boost::system::error_code& ec) { on_tick(ec); });
+    }
+
+    void on_tick(const boost::system::error_code& ec)
+    {
+        if (ec) {
+            return;
+        }
+        // catch up if the io_context was busy for more than a tick
+        const auto target = static_cast<std::uint64_t>(
+            (clock_t::now() - start_) / timing_wheel_t::resolution);
+        while (wheel_.now() < target) {
+            wheel_.advance();
+        }
+        arm();
+    }
+
+    timing_wheel_t wheel_;
+    net::steady_timer timer_;
+    clock_t::time_point start_;
+};
+
+net::execution_context::id timing_wheel_service_t::id;
+
+}
+
+timing_wheel_t::entry_t::~entry_t()
+{
+    unlink();
+}
+
+void timing_wheel_t::entry_t::on_expired(std::function<void()> handler)
+{
+    handler_ = std::move(handler);
+}
+
+void timing_wheel_t::entry_t::unlink()
+{
+    prev->next = next;
+    next->prev = prev;
+    prev = this;
+    next = this;
+}
+
+timing_wheel_t& timing_wheel_t::of(const net::any_io_executor& executor)
+{
+    // all the executors of the server are the ones of its io_context
+    auto& context = net::query(executor, net::execution::context);
+    return net::use_service<timing_wheel_service_t>(
+               static_cast<net::io_context&>(context))
+        .wheel();
+}
+
+void timing_wheel_t::expires_after(entry_t& entry, clock_t::duration timeout)
+{
+    // the current tick is partly elapsed, one more tick so that
+    // entries never expire early
+    const auto ticks = std::max<std::int64_t>(
+        (timeout + resolution - clock_t::duration{1}) / resolution, 0);
+    const auto deadline = now_ + 1 + static_cast<std::uint64_t>(ticks);
+
+    if (entry.scheduled() && deadline >= entry.deadline_) {
+        entry.deadline_ = deadline;
+        return;
+    }
+    entry.unlink();
+    entry.deadline_ = deadline;
+    link(entry);
+}
+
+void timing_wheel_t::cancel(entry_t& entry)
+{
+    entry.unlink();
+}
+
+void timing_wheel_t::advance()
+{
+    ++now_;
+    auto& bucket = buckets_[now_ % buckets];
+
+    // expired entries are moved aside first, handlers may reschedule
+    // or destroy any entry
+    link_t expired;
+    for (auto* it = bucket.next; it != &bucket;) {
+        auto& entry = static_cast<entry_t&>(*it);
+        it = it->next;
+        if (entry.deadline_ > now_) {
+            if (entry.deadline_ % buckets != now_ % buckets) {
+                // postponed since it was linked
+                entry.unlink();
+                link(entry);
+            }
+            continue;
+        }
+        entry.unlink();
+        entry.prev = expired.prev;
+        entry.next = &expired;
+        expired.prev->next = &entry;
+        expired.prev = &entry;
+    }
+
+    while (expired.next != &expired) {
+        auto& entry = static_cast<entry_t&>(*expired.next);
+        entry.unlink();
+        if (entry.deadline_ > now_) {
+            // postponed by an earlier handler, still scheduled
+            link(entry);
+            continue;
+        }
+        if (entry.handler_) {
+            entry.handler_();
+        }
+    }
+}
+
+void timing_wheel_t::link(entry_t& entry)
+{
+    auto& bucket = buckets_[entry.deadline_ % buckets];
+    entry.prev = bucket.prev;
+    entry.next = &bucket;
+    bucket.prev->next = &entry;
+    bucket.prev = &entry;
+}
+
+} // sd
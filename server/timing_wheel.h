@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "config.h"
+
+namespace sd {
+
+// Coarse timeouts: a hashed timing wheel. Scheduling an entry is O(1)
+// and allocation free, the entries expiring at the same tick are
+// handled together. The wheel of an io_context is shared by everything
+// running on it and advanced in real time by a single timer, other
+// wheels are advanced by their owner.
+class timing_wheel_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    // deadlines are rounded up to the next tick, entries expire up to
+    // one tick late
+    static constexpr auto resolution = std::chrono::seconds{1};
+    // longer timeouts stay in their bucket for several turns
+    static constexpr std::size_t buckets = 64;
+
+    struct link_t {
+        link_t* prev{this};
+        link_t* next{this};
+    };
+
+    // Deadline of one owner, linked in the wheel while scheduled.
+    // Destroying it cancels it.
+    class entry_t : private link_t {
+    public:
+        entry_t() = default;
+        ~entry_t();
+
+        entry_t(const entry_t&) = delete;
+        entry_t(entry_t&&) = delete;
+        entry_t& operator=(const entry_t&) = delete;
+        entry_t& operator=(entry_t&&) = delete;
+
+        // called from the wheel, the entry is no longer scheduled
+        void on_expired(std::function<void()> handler);
+        [[nodiscard]] bool scheduled() const { return next != this; }
+
+    private:
+        friend class timing_wheel_t;
+
+        void unlink();
+
+        std::function<void()> handler_;
+        std::uint64_t deadline_{0};
+    };
+
+    timing_wheel_t() = default;
+
+    timing_wheel_t(const timing_wheel_t&) = delete;
+    timing_wheel_t(timing_wheel_t&&) = delete;
+    timing_wheel_t& operator=(const timing_wheel_t&) = delete;
+    timing_wheel_t& operator=(timing_wheel_t&&) = delete;
+
+    // the wheel of the io_context running the executor, only used from
+    // the thread running it
+    static timing_wheel_t& of(const net::any_io_executor& executor);
+
+    // Schedules or reschedules the entry. Postponing a scheduled entry
+    // only updates its deadline, it is moved when its bucket comes up.
+    void expires_after(entry_t& entry, clock_t::duration timeout);
+    void cancel(entry_t& entry);
+
+    // moves time forward by one tick, the entries due expire
+    void advance();
+    [[nodiscard]] std::uint64_t now() const { return now_; }
+
+private:
+    void link(entry_t& entry);
+
+    std::uint64_t now_{0};
+    std::array<link_t, buckets> buckets_;
+};
+
+} // sd
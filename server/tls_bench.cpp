@@ -0,0 +1,318 @@
+// TLS benchmark: connects to an in-process wss:// server over loopback,
+// one connection after the other, in plain text, with full TLS
+// handshakes and with the session resumed from the ticket of the
+// previous connection. Reports the CPU time the server spends per
+// connection and the reconnect latency seen by the client, up to the
+// registration. Uses $TLS_CERT and $TLS_KEY, or a self-signed ECDSA
+// P-256 certificate generated for the run.
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <boost/beast/ssl.hpp>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <spdlog/spdlog.h>
+
+#include "client_stream.h"
+#include "latency_histogram.h"
+#include "session.h"
+#include "tls_context.h"
+
+using namespace sd;
+
+namespace {
+
+constexpr auto connections_envvar = "TLS_BENCH_CONNECTIONS";
+constexpr auto tls_cert_envvar = "TLS_CERT";
+constexpr auto tls_key_envvar = "TLS_KEY";
+
+constexpr auto registration =
+    R"({"command":{"register":{"id":"6f1c52ef-7b44-4e1b-a2d5-4dc3f0b9b6e1","name":"bench"}}})";
+
+enum class bench_mode_t { plain, full_handshake, resumed };
+
+struct result_t {
+    std::chrono::nanoseconds server_cpu{0};
+    latency_histogram_t latency;
+    std::int64_t resumed{0};
+};
+
+template <typename T, void (*Free)(T*)>
+struct openssl_deleter_t {
+    void operator()(T* p) const { Free(p); }
+};
+using pkey_ptr_t =
+    std::unique_ptr<EVP_PKEY, openssl_deleter_t<EVP_PKEY, EVP_PKEY_free>>;
+using pkey_ctx_ptr_t = std::unique_ptr<
+    EVP_PKEY_CTX,
+    openssl_deleter_t<EVP_PKEY_CTX, EVP_PKEY_CTX_free>>;
+using x509_ptr_t = std::unique_ptr<X509, openssl_deleter_t<X509, X509_free>>;
+using session_ptr_t = std::unique_ptr<
+    SSL_SESSION,
+    openssl_deleter_t<SSL_SESSION, SSL_SESSION_free>>;
+
+void write_pem(const std::filesystem::path& path, auto write)
+{
+    std::unique_ptr<FILE, decltype(&std::fclose)> file{
+        std::fopen(path.c_str(), "w"), &std::fclose};
+    if (!file || write(file.get()) != 1) {
+        throw std::runtime_error{"can't write " + path.string()};
+    }
+}
+
+// self-signed, valid for a day
+tls_config_t generate_certificate(const std::filesystem::path& dir)
+{
+    pkey_ctx_ptr_t key_ctx{EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr)};
+    EVP_PKEY* raw_key = nullptr;
+    if (!key_ctx || EVP_PKEY_keygen_init(key_ctx.get()) != 1
+        || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+               key_ctx.get(), NID_X9_62_prime256v1)
+            != 1
+        || EVP_PKEY_keygen(key_ctx.get(), &raw_key) != 1) {
+        throw std::runtime_error{"can't generate the key"};
+    }
+    const pkey_ptr_t key{raw_key};
+
+    const x509_ptr_t cert{X509_new()};
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 3600);
+    auto* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(
+        name,
+        "CN",
+        MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>("localhost"), // NOLINT
+        -1,
+        -1,
+        0);
+    X509_set_issuer_name(cert.get(), name);
+    X509_set_pubkey(cert.get(), key.get());
+    if (X509_sign(cert.get(), key.get(), EVP_sha256()) == 0) {
+        throw std::runtime_error{"can't sign the certificate"};
+    }
+
+    tls_config_t config{dir / "cert.pem", dir / "key.pem"};
+    write_pem(config.certificate_file, [&](FILE* file) {
+        return PEM_write_X509(file, cert.get());
+    });
+    write_pem(config.private_key_file, [&](FILE* file) {
+        return PEM_write_PrivateKey(
+            file, key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+    });
+    return config;
+}
+
+std::chrono::nanoseconds thread_cpu_time()
+{
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+// Accepts the connections the way the listener and the sessions do,
+// up to the registration, then closes them
+class server_t {
+public:
+    server_t(std::shared_ptr<net::ssl::context> tls, int connections)
+        : tls_{std::move(tls)}, connections_{connections}
+    {
+        acceptor_.open(tcp::v4());
+        acceptor_.bind({net::ip::address_v4::loopback(), 0});
+        acceptor_.listen();
+        thread_ = std::thread{[this]() { run(); }};
+    }
+
+    ~server_t()
+    {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    server_t(const server_t&) = delete;
+    server_t(server_t&&) = delete;
+    server_t& operator=(const server_t&) = delete;
+    server_t& operator=(server_t&&) = delete;
+
+    [[nodiscard]] tcp::endpoint endpoint() const
+    {
+        return acceptor_.local_endpoint();
+    }
+
+    // once the client is done
+    std::chrono::nanoseconds cpu_time()
+    {
+        thread_.join();
+        return cpu_time_;
+    }
+
+private:
+    void run()
+    {
+        const auto start = thread_cpu_time();
+        net::co_spawn(ioc_, serve(), net::detached);
+        ioc_.run();
+        cpu_time_ = thread_cpu_time() - start;
+    }
+
+    net::awaitable<void> serve()
+    {
+        for (int i = 0; i < connections_; ++i) {
+            auto tcp_socket =
+                co_await acceptor_.async_accept(net::use_awaitable);
+            tcp_socket.set_option(tcp::no_delay{true});
+            stream_socket_t socket{std::move(tcp_socket)};
+            websocket_stream_t ws{
+                tls_ ? client_stream_t{std::move(socket), *tls_}
+                     : client_stream_t{std::move(socket)}};
+            try {
+                parse_registration(co_await accept_registration(ws));
+                co_await ws.async_close(
+                    websocket::close_code::normal, net::use_awaitable);
+            }
+            catch (const boost::system::system_error& exc) {
+                spdlog::error("server: {}", exc.what());
+            }
+        }
+    }
+
+    std::shared_ptr<net::ssl::context> tls_;
+    int connections_;
+    net::io_context ioc_{1};
+    tcp::acceptor acceptor_{ioc_};
+    std::chrono::nanoseconds cpu_time_{0};
+    std::thread thread_;
+};
+
+void connect(beast::tcp_stream& stream, const tcp::endpoint& endpoint)
+{
+    stream.connect(endpoint);
+    // the handshake flights are not held back waiting for acks
+    stream.socket().set_option(tcp::no_delay{true});
+}
+
+// the client session is kept from one connection to the next when
+// resuming, the ticket comes with the first websocket messages
+template <typename Stream>
+void exchange(websocket::stream<Stream>& ws)
+{
+    ws.handshake("localhost", "/");
+    ws.write(net::buffer(std::string_view{registration}));
+    beast::flat_buffer buffer;
+    beast::error_code ec;
+    ws.read(buffer, ec);
+    if (ec != websocket::error::closed) {
+        throw beast::system_error{ec};
+    }
+}
+
+result_t run(bench_mode_t mode, const tls_config_t& config, int connections)
+{
+    std::shared_ptr<net::ssl::context> server_tls;
+    if (mode != bench_mode_t::plain) {
+        auto server_config = config;
+        server_config.resumption = mode == bench_mode_t::resumed;
+        server_tls = make_tls_context(server_config);
+    }
+    server_t server{server_tls, connections};
+
+    net::io_context ioc{1};
+    net::ssl::context client_tls{net::ssl::context::tls_client};
+    result_t result;
+    session_ptr_t session;
+    for (int i = 0; i < connections; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        if (mode == bench_mode_t::plain) {
+            websocket::stream<beast::tcp_stream> ws{ioc};
+            connect(beast::get_lowest_layer(ws), server.endpoint());
+            exchange(ws);
+            result.latency.record(std::chrono::steady_clock::now() - start);
+            continue;
+        }
+
+        websocket::stream<beast::ssl_stream<beast::tcp_stream>> ws{
+            ioc, client_tls};
+        connect(beast::get_lowest_layer(ws), server.endpoint());
+        auto* ssl = ws.next_layer().native_handle();
+        if (session) {
+            SSL_set_session(ssl, session.get());
+        }
+        ws.next_layer().handshake(net::ssl::stream_base::client);
+        exchange(ws);
+        result.latency.record(std::chrono::steady_clock::now() - start);
+
+        if (SSL_session_reused(ssl) != 0) {
+            ++result.resumed;
+        }
+        session.reset(SSL_get1_session(ssl));
+    }
+    result.server_cpu = server.cpu_time() / connections;
+    return result;
+}
+
+void report(std::string_view name, const result_t& result, int connections)
+{
+    spdlog::info(
+        "{}: server cpu {}us per connection, reconnect p50 {}us, p99 {}us, "
+        "{}/{} resumed",
+        name,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            result.server_cpu)
+            .count(),
+        result.latency.percentile(0.5).count(), // NOLINT(*-magic-numbers)
+        result.latency.percentile(0.99).count(), // NOLINT(*-magic-numbers)
+        result.resumed,
+        connections);
+}
+
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const auto* mb_connections = std::getenv(connections_envvar);
+    const int connections = mb_connections ? std::atoi(mb_connections) : 1000;
+
+    std::optional<std::filesystem::path> temp_dir;
+    tls_config_t config;
+    if (const auto* cert = std::getenv(tls_cert_envvar)) {
+        const auto* key = std::getenv(tls_key_envvar);
+        config = {cert, key ? key : cert};
+    }
+    else {
+        std::string dir_template =
+            std::filesystem::temp_directory_path() / "tls_bench.XXXXXX";
+        if (::mkdtemp(dir_template.data()) == nullptr) {
+            spdlog::error("can't create a temporary directory");
+            return EXIT_FAILURE;
+        }
+        temp_dir = dir_template;
+        config = generate_certificate(*temp_dir);
+    }
+
+    spdlog::info("{} connections per mode", connections);
+    report("plain", run(bench_mode_t::plain, config, connections), connections);
+    report(
+        "tls, full handshakes",
+        run(bench_mode_t::full_handshake, config, connections),
+        connections);
+    report(
+        "tls, resumed",
+        run(bench_mode_t::resumed, config, connections),
+        connections);
+
+    if (temp_dir) {
+        std::filesystem::remove_all(*temp_dir);
+    }
+    return EXIT_SUCCESS;
+}
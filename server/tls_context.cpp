@@ -0,0 +1,35 @@
+#include "tls_context.h"
+
+#include <openssl/ssl.h>
+
+namespace sd {
+
+std::shared_ptr<net::ssl::context> make_tls_context(const tls_config_t& config)
+{
+    auto context =
+        std::make_shared<net::ssl::context>(net::ssl::context::tls_server);
+    context->set_options(
+        net::ssl::context::default_workarounds | net::ssl::context::no_sslv2
+        | net::ssl::context::no_sslv3 | net::ssl::context::no_tlsv1
+        | net::ssl::context::no_tlsv1_1 | net::ssl::context::single_dh_use);
+    context->use_certificate_chain_file(config.certificate_file);
+    context->use_private_key_file(
+        config.private_key_file, net::ssl::context::pem);
+
+    auto* native = context->native_handle();
+    // resumption only relies on tickets, there is no session cache
+    SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_OFF);
+    if (config.resumption) {
+        SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+        // a client reconnects with the latest ticket, issuing a second
+        // one per handshake (the TLS 1.3 default) is wasted
+        SSL_CTX_set_num_tickets(native, 1);
+    }
+    else {
+        SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(native, 0);
+    }
+    return context;
+}
+
+} // sd
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <boost/asio/ssl/context.hpp>
+
+#include "config.h"
+
+namespace sd {
+
+struct tls_config_t {
+    // PEM files, the certificate file may hold the whole chain
+    std::string certificate_file;
+    std::string private_key_file;
+    // Session tickets let reconnecting clients skip the full handshake.
+    // They are stateless: the server keeps nothing per TLS session.
+    bool resumption{true};
+};
+
+// Server context for wss:// connections, shared by all of them.
+// Throws boost::system::system_error if a file can't be loaded.
+std::shared_ptr<net::ssl::context> make_tls_context(
+    const tls_config_t& config);
+
+} // sd
@@ -0,0 +1,112 @@
+#include "trace.h"
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+namespace sd {
+
+namespace {
+
+constexpr std::size_t spans_per_thread = 1 << 16;
+
+struct span_t {
+    const char* name;
+    std::int64_t start_ns;
+    std::int64_t duration_ns;
+};
+
+// Written by a single thread, dumps read it from any thread:
+// spans being overwritten during a dump may be inconsistent,
+// which is acceptable for diagnostics.
+struct thread_buffer_t {
+    int tid;
+    std::atomic<std::uint64_t> count{0};
+    std::array<span_t, spans_per_thread> spans;
+};
+
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<thread_buffer_t>> buffers;
+
+thread_buffer_t& this_thread_buffer()
+{
+    thread_local thread_buffer_t* buffer = []() {
+        auto new_buffer = std::make_unique<thread_buffer_t>();
+        const std::lock_guard lock{buffers_mutex};
+        new_buffer->tid = static_cast<int>(buffers.size()) + 1;
+        // buffers outlive their thread so that they can still be dumped
+        return buffers.emplace_back(std::move(new_buffer)).get();
+    }();
+    return *buffer;
+}
+
+std::int64_t to_ns(trace_scope_t::clock_t::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               tp.time_since_epoch())
+        .count();
+}
+
+}
+
+trace_scope_t::~trace_scope_t()
+{
+    auto& buffer = this_thread_buffer();
+    const auto idx = buffer.count.load(std::memory_order_relaxed);
+    buffer.spans[idx % spans_per_thread] = {
+        name_, to_ns(start_), to_ns(clock_t::now()) - to_ns(start_)};
+    buffer.count.store(idx + 1, std::memory_order_release);
+}
+
+bool dump_trace(const std::string& path)
+{
+    std::unique_ptr<FILE, decltype(&fclose)> file{
+        fopen(path.c_str(), "w"), &fclose};
+    if (!file) {
+        return false;
+    }
+
+    constexpr double ns_per_us = 1000.;
+    const auto pid = getpid();
+    fprintf(file.get(), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    const std::lock_guard lock{buffers_mutex};
+    bool first = true;
+    for (const auto& buffer : buffers) {
+        fprintf(
+            file.get(),
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"thread %d\"}}",
+            first ? "" : ",",
+            pid,
+            buffer->tid,
+            buffer->tid);
+        first = false;
+
+        const auto count = buffer->count.load(std::memory_order_acquire);
+        const auto begin = count > spans_per_thread ? count - spans_per_thread
+                                                    : 0;
+        for (auto i = begin; i < count; ++i) {
+            const auto& span = buffer->spans[i % spans_per_thread];
+            fprintf(
+                file.get(),
+                ",{\"name\":\"%s\",\"cat\":\"sd\",\"ph\":\"X\",\"ts\":%.3f,"
+                "\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                span.name,
+                static_cast<double>(span.start_ns) / ns_per_us,
+                static_cast<double>(span.duration_ns) / ns_per_us,
+                pid,
+                buffer->tid);
+        }
+    }
+
+    fprintf(file.get(), "]}\n");
+    return ferror(file.get()) == 0;
+}
+
+} // sd
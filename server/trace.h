@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace sd {
+
+// Lightweight tracing spans, compiled out unless SD_ENABLE_TRACING
+// is defined. Each thread records its spans into its own ring buffer,
+// older spans are overwritten. The buffers can be dumped at any time
+// as a Chrome trace-event JSON file, to be loaded in Perfetto or
+// chrome://tracing.
+#ifdef SD_ENABLE_TRACING
+constexpr bool tracing_enabled = true;
+#else
+constexpr bool tracing_enabled = false;
+#endif
+
+class trace_scope_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    // name must be a string literal, only the pointer is stored
+    explicit trace_scope_t(const char* name)
+        : name_{name}, start_{clock_t::now()}
+    {
+    }
+    ~trace_scope_t();
+
+    trace_scope_t(const trace_scope_t&) = delete;
+    trace_scope_t(trace_scope_t&&) = delete;
+    trace_scope_t& operator=(const trace_scope_t&) = delete;
+    trace_scope_t& operator=(trace_scope_t&&) = delete;
+
+private:
+    const char* name_;
+    clock_t::time_point start_;
+};
+
+// Write the spans recorded by all threads, returns false on error
+bool dump_trace(const std::string& path);
+
+} // sd
+
+#define SD_TRACE_CONCAT_IMPL(a, b) a##b
+#define SD_TRACE_CONCAT(a, b) SD_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef SD_ENABLE_TRACING
+#define SD_TRACE_SCOPE(name) \
+    const ::sd::trace_scope_t SD_TRACE_CONCAT(sd_trace_, __LINE__)(name)
+#else
+#define SD_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
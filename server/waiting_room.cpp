@@ -0,0 +1,225 @@
+#include "waiting_room.h"
+#include "session.h"
+#include "world.h"
+
+#include <nlohmann/json.hpp>
+
+namespace sd {
+
+namespace {
+
+constexpr auto status_period = std::chrono::seconds{1};
+// weight of the last admission interval in the average
+constexpr double admission_interval_alpha = 0.2;
+
+}
+
+struct waiting_room_t::waiter_t {
+    explicit waiter_t(client_stream_t&& stream)
+        : ws{std::move(stream)}, wakeup{ws.get_executor()}
+    {
+    }
+    waiter_t(websocket_stream_t&& accepted, registration_t registration)
+        : ws{std::move(accepted)},
+          wakeup{ws.get_executor()},
+          registration{std::move(registration)}
+    {
+    }
+
+    websocket_stream_t ws;
+    net::steady_timer wakeup;
+    registration_t registration;
+    std::shared_ptr<world_t> world;
+    player_handle_t player;
+    std::optional<std::string> rejected;
+};
+
+waiting_room_t::waiting_room_t(
+    std::vector<std::shared_ptr<world_t>> worlds,
+    std::size_t max_size)
+    : worlds_{std::move(worlds)}, max_size_{max_size}
+{
+}
+
+waiting_room_t::~waiting_room_t() = default;
+
+bool waiting_room_t::full() const
+{
+    return queue_.size() + entering_ >= max_size_;
+}
+
+void waiting_room_t::enter(client_stream_t&& stream)
+{
+    ++entering_;
+    auto waiter = std::make_shared<waiter_t>(std::move(stream));
+    auto executor = waiter->ws.get_executor();
+    net::co_spawn(
+        executor,
+        [self = shared_from_this(),
+         waiter = std::move(waiter)]() -> net::awaitable<void> {
+            co_await self->wait(waiter);
+        },
+        net::detached);
+}
+
+void waiting_room_t::enter(websocket_stream_t&& ws, registration_t registration)
+{
+    auto waiter =
+        std::make_shared<waiter_t>(std::move(ws), std::move(registration));
+    auto executor = waiter->ws.get_executor();
+    net::co_spawn(
+        executor,
+        [self = shared_from_this(),
+         waiter = std::move(waiter)]() -> net::awaitable<void> {
+            co_await self->wait_for_place(waiter);
+        },
+        net::detached);
+}
+
+net::awaitable<void> waiting_room_t::wait(std::shared_ptr<waiter_t> waiter)
+{
+    std::optional<beast::websocket::close_reason> close_reason;
+    try {
+        auto msg = co_await accept_registration(waiter->ws);
+        waiter->registration = parse_registration(msg);
+    }
+    catch (const registration_error& exc) {
+        close_reason.emplace(exc.what());
+    }
+    catch (const boost::system::system_error&) {
+        --entering_;
+        co_return;
+    }
+    --entering_;
+
+    if (close_reason) {
+        co_await waiter->ws.async_close(*close_reason, net::use_awaitable);
+        co_return;
+    }
+
+    co_await wait_for_place(std::move(waiter));
+}
+
+net::awaitable<void> waiting_room_t::wait_for_place(
+    std::shared_ptr<waiter_t> waiter)
+{
+    queue_.push_back(waiter);
+    admit();
+
+    while (!waiter->player && !waiter->rejected) {
+        try {
+            const auto msg = queue_status(*waiter);
+            co_await waiter->ws.async_write(net::buffer(msg), net::use_awaitable);
+        }
+        catch (const boost::system::system_error&) {
+            // the client left, if it was admitted in the meantime
+            // the player handle unregisters it
+            queue_.remove(waiter);
+            co_return;
+        }
+
+        if (waiter->player || waiter->rejected) {
+            break;
+        }
+
+        // woken up early when admitted
+        boost::system::error_code ec;
+        waiter->wakeup.expires_after(status_period);
+        co_await waiter->wakeup.async_wait(
+            net::redirect_error(net::use_awaitable, ec));
+    }
+
+    if (waiter->rejected) {
+        co_await waiter->ws.async_close(
+            beast::websocket::close_reason{*waiter->rejected},
+            net::use_awaitable);
+        co_return;
+    }
+
+    std::make_shared<session_t>(
+        std::move(waiter->world),
+        std::move(waiter->player),
+        std::move(waiter->ws))
+        ->run();
+}
+
+void waiting_room_t::admit()
+{
+    for (auto it = begin(queue_); it != end(queue_);) {
+        auto& waiter = **it;
+        auto world = find_world(waiter.registration.player_id);
+        if (!world) {
+            // keep looking, players further in the queue
+            // may still have a reservation in a world
+            ++it;
+            continue;
+        }
+
+        try {
+            waiter.player = world->register_player(
+                waiter.registration.player_id,
+                waiter.registration.player_name);
+            waiter.world = std::move(world);
+            record_admission();
+        }
+        catch (const std::runtime_error& exc) {
+            waiter.rejected.emplace(exc.what());
+        }
+
+        waiter.wakeup.cancel();
+        it = queue_.erase(it);
+    }
+}
+
+std::shared_ptr<world_t> waiting_room_t::find_world(
+    const player_id_t& player_id) const
+{
+    for (const auto& world : worlds_) {
+        if (world->has_reservation(player_id)) {
+            return world;
+        }
+    }
+    for (const auto& world : worlds_) {
+        if (world->available_places() > 0) {
+            return world;
+        }
+    }
+    return {};
+}
+
+std::string waiting_room_t::queue_status(const waiter_t& waiter) const
+{
+    std::size_t position = 1;
+    for (const auto& other : queue_) {
+        if (other.get() == &waiter) {
+            break;
+        }
+        ++position;
+    }
+
+    nlohmann::json estimated_wait;
+    if (admission_interval_) {
+        estimated_wait =
+            admission_interval_->count() * static_cast<double>(position);
+    }
+
+    return nlohmann::json{
+        {"queue", {{"position", position}, {"estimated_wait", estimated_wait}}}}
+        .dump();
+}
+
+void waiting_room_t::record_admission()
+{
+    const auto now = clock_t::now();
+    if (last_admission_) {
+        const std::chrono::duration<double> interval = now - *last_admission_;
+        admission_interval_ =
+            admission_interval_
+                ? admission_interval_alpha * interval
+                      + (1 - admission_interval_alpha) * *admission_interval_
+                : interval;
+    }
+    last_admission_ = now;
+}
+
+} // sd
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "session.h"
+
+namespace sd {
+
+// Clients that could not find a place in any world wait here:
+// the websocket handshake is completed, they are told their position
+// in the queue and the estimated wait, and they are registered in a
+// world as soon as a place becomes available.
+class waiting_room_t : public std::enable_shared_from_this<waiting_room_t> {
+public:
+    waiting_room_t(
+        std::vector<std::shared_ptr<world_t>> worlds,
+        std::size_t max_size);
+    ~waiting_room_t();
+
+    waiting_room_t(const waiting_room_t&) = delete;
+    waiting_room_t(waiting_room_t&&) = delete;
+    waiting_room_t& operator=(const waiting_room_t&) = delete;
+    waiting_room_t& operator=(waiting_room_t&&) = delete;
+
+    [[nodiscard]] bool full() const;
+
+    void enter(client_stream_t&& stream);
+    // the websocket is already accepted and the registration read
+    void enter(websocket_stream_t&& ws, registration_t registration);
+    // register waiting clients in worlds that have places available
+    void admit();
+
+private:
+    using clock_t = std::chrono::steady_clock;
+    struct waiter_t;
+
+    net::awaitable<void> wait(std::shared_ptr<waiter_t> waiter);
+    net::awaitable<void> wait_for_place(std::shared_ptr<waiter_t> waiter);
+    std::shared_ptr<world_t> find_world(const player_id_t& player_id) const;
+    std::string queue_status(const waiter_t& waiter) const;
+    void record_admission();
+
+    std::vector<std::shared_ptr<world_t>> worlds_;
+    std::size_t max_size_;
+    std::list<std::shared_ptr<waiter_t>> queue_;
+    // clients in the middle of the handshake
+    std::size_t entering_{0};
+    std::optional<clock_t::time_point> last_admission_;
+    std::optional<std::chrono::duration<double>> admission_interval_;
+};
+
+} // sd
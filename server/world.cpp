@@ -1,192 +1,408 @@
 #include "world.h"
+#include "event_log.h"
 #include "player.h"
+#include "shm_exporter.h"
+#include "timing_wheel.h"
+#include "trace.h"
 
 #include <array>
 
-#include <boost/uuid/uuid_io.hpp>
-
 namespace sd {
 
 namespace {
 
-constexpr auto check_idle_dt = std::chrono::seconds{1};
-
-// an IDLE player keeps a reserved spot in the world
-// this means he can reconnect to play with the same
-// players and will keep his score
-// In the meantime, a bot takes his place
-constexpr auto idle_duration = std::chrono::minutes{5};
+constexpr auto tick_stats_period = std::chrono::minutes{1};
+// run on a full world before the world is scheduled, to estimate the
+// cost of its ticks
+constexpr int warm_up_ticks = 10;
+
+static_assert(world_t::capacity <= shm_max_players);
+static_assert(player_name_max_length <= shm_name_size);
+static_assert(sizeof(player_id_t) == sizeof(shm_player_t::id));
+
+constexpr auto fake_player_names = std::array{
+    "Rambo",
+    "Borg",
+    "Chuck Norris",
+    "Bruce Lee",
+    "Hubert Bonisseur de La Bath",
+    "Mickey O'Neil",
+    "Luke",
+    "Spock",
+};
 
-constexpr std::size_t max_players = 8;
+}
 
-std::string get_fake_player_name(
-    const std::vector<std::unique_ptr<player_t>>& current_players)
+struct world_t::slot_t {
+    std::optional<player_t> player;
+    // incremented each time the player leaves the slot,
+    // handles of previous players no longer resolve
+    std::uint32_t generation{0};
+    // set while the place is reserved for a disconnected player
+    std::optional<clock_t::time_point> idle_since;
+    // end of the reservation
+    timing_wheel_t::entry_t idle_expiry;
+
+    [[nodiscard]] bool active() const { return player && !idle_since; }
+    [[nodiscard]] bool idle() const { return player && idle_since; }
+};
+
+world_t::world_t(net::io_context& ioc)
+    : world_t{ioc, timing_wheel_t::of(ioc.get_executor())}
 {
-    static const auto names = std::array{
-        "Rambo",
-        "Borg",
-        "Chuck Norris",
-        "Bruce Lee",
-        "Hubert Bonisseur de La Bath",
-        "Mickey O'Neil",
-        "Luke",
-        "Spock",
-    };
-    int idx = 0;
-    for (const auto& name : names) {
-        auto it = find_if(
-            begin(current_players), end(current_players), [&](const auto& p) {
-                return name == p->name();
-            });
-        if (it == end(current_players)) {
-            return name;
-        }
-    }
-    return names.back();
 }
 
+world_t::world_t(net::io_context& ioc, timing_wheel_t& timing_wheel)
+    : ioc_{ioc},
+      timing_wheel_{timing_wheel},
+      slots_(capacity),
+      rnd_gen_{std::random_device{}()},
+      uuid_generator_{&rnd_gen_}
+{
+    for (auto& slot : slots_) {
+        slot.idle_expiry.on_expired(
+            [this, &slot]() { expire_reservation(slot); });
+    }
 }
 
-world_t::world_t(net::io_context& ioc) : ioc_{ioc}, uuid_generator_{} {}
-
 world_t::~world_t() = default;
 
 std::size_t world_t::real_players() const
 {
-    return active_real_players() + idle_players_.size();
+    return static_cast<std::size_t>(
+        count_if(begin(slots_), end(slots_), [](const auto& slot) {
+            return slot.player && !slot.player->fake();
+        }));
 }
 
 std::size_t world_t::active_real_players() const
 {
-    return players_.size() - fake_players_.size();
+    return static_cast<std::size_t>(
+        count_if(begin(slots_), end(slots_), [](const auto& slot) {
+            return slot.active() && !slot.player->fake();
+        }));
+}
+
+std::size_t world_t::fake_players() const
+{
+    return static_cast<std::size_t>(
+        count_if(begin(slots_), end(slots_), [](const auto& slot) {
+            return slot.player && slot.player->fake();
+        }));
 }
 
 std::size_t world_t::available_places() const
 {
-    return max_players - real_players();
+    // never underflow, a full world would look empty
+    const auto real = real_players();
+    return real >= max_players ? 0 : max_players - real;
+}
+
+bool world_t::has_reservation(const player_id_t& player_id) const
+{
+    return any_of(begin(slots_), end(slots_), [&](const auto& slot) {
+        return slot.idle() && slot.player->id() == player_id;
+    });
+}
+
+void world_t::on_places_available(std::function<void()> handler)
+{
+    places_available_handler_ = std::move(handler);
 }
 
 player_handle_t world_t::register_player(
     const player_id_t& player_id,
     std::string_view player_name)
 {
-    return register_player(player_id, player_name, false);
+    auto& slot = add_player(player_id, player_name, false);
+    // bots live in the slots directly, they are adjusted right away
+    // instead of from a posted handler, which would allocate
+    adjust_players();
+    return {
+        *this,
+        static_cast<std::uint32_t>(&slot - slots_.data()),
+        slot.generation,
+    };
 }
 
-player_handle_t world_t::register_player(
+world_t::slot_t& world_t::add_player(
     const player_id_t& player_id,
     std::string_view player_name,
     bool fake)
 {
-    auto player_it = find_if(begin(players_), end(players_), [&](const auto& p) {
-        return p->id() == player_id;
-    });
-    if (player_it != end(players_)) {
+    SD_TRACE_SCOPE("world_t::register_player");
+
+    auto* slot = find_slot(player_id);
+    if (slot != nullptr && slot->active()) {
         // player already registered
         throw player_already_registered{};
     }
 
-    auto idle_it =
-        find_if(begin(idle_players_), end(idle_players_), [&](const auto& p) {
-            return p.player->id() == player_id;
-        });
-    if (idle_it != end(idle_players_)) {
-        players_.emplace_back(std::move(idle_it->player));
-        players_.back()->respawn();
-        idle_players_.erase(idle_it);
-        spdlog::info("restoring player {} ({})", player_name, to_string(player_id));
+    if (slot != nullptr) {
+        slot->idle_since.reset();
+        timing_wheel_.cancel(slot->idle_expiry);
+        slot->player->respawn();
+        log_player_event(event_kind_t::player_restored, player_id, player_name);
     }
     else {
-        players_.emplace_back(
-            std::make_unique<player_t>(*this, player_id, player_name, fake));
+        if (!fake && available_places() == 0) {
+            throw world_full{};
+        }
+        auto slot_it = find_if(begin(slots_), end(slots_), [](const auto& s) {
+            return !s.player;
+        });
+        if (slot_it == end(slots_)) {
+            throw world_full{};
+        }
+        slot = &*slot_it;
+        slot->player.emplace(*this, player_id, player_name, fake);
 
         if (!fake) {
-            spdlog::info(
-                "registering player {} ({})", player_name, to_string(player_id));
+            log_player_event(
+                event_kind_t::player_registered, player_id, player_name);
         }
     }
+    return *slot;
+}
 
-    net::post(ioc_, [this]() { adjust_players(); });
-    return {
-        players_.back().get(),
-        [self = shared_from_this()](player_t* p) { self->unregister_player(*p); },
-    };
+player_t* world_t::find_player(std::uint32_t index, std::uint32_t generation)
+{
+    auto& slot = slots_[index];
+    if (slot.generation != generation || !slot.active()) {
+        return nullptr;
+    }
+    return &*slot.player;
 }
 
-void world_t::unregister_player(const player_t& p)
+world_t::slot_t* world_t::find_slot(const player_id_t& player_id)
 {
-    auto it = find_if(begin(players_), end(players_), [&](const auto& player) {
-        return p == *player;
+    auto slot_it = find_if(begin(slots_), end(slots_), [&](const auto& slot) {
+        return slot.player && slot.player->id() == player_id;
     });
-    if (it == end(players_)) {
-        spdlog::warn(
-            "unregistering unknown player {} ({})", p.name(), to_string(p.id()));
+    return slot_it == end(slots_) ? nullptr : &*slot_it;
+}
+
+void world_t::unregister_player(std::uint32_t index, std::uint32_t generation)
+{
+    auto& slot = slots_[index];
+    if (slot.generation != generation || !slot.active()) {
+        log_player_event(event_kind_t::player_unknown, {}, {});
         return;
     }
 
+    const auto& p = *slot.player;
     if (!p.fake()) {
-        idle_players_.push_back({clock_t::now(), std::move(*it)});
-        spdlog::info("moving player {} to idle ({})", p.name(), to_string(p.id()));
+        slot.idle_since = clock_t::now();
+        timing_wheel_.expires_after(slot.idle_expiry, idle_duration);
+        ++slot.generation;
+        log_player_event(event_kind_t::player_idle, p.id(), p.name());
+    }
+    else {
+        remove_player(slot);
     }
 
-    players_.erase(it);
+    adjust_players();
+}
+
+void world_t::remove_player(slot_t& slot)
+{
+    slot.player.reset();
+    slot.idle_since.reset();
+    timing_wheel_.cancel(slot.idle_expiry);
+    ++slot.generation;
+}
 
-    net::post(ioc_, [this]() { adjust_players(); });
+std::string_view world_t::fake_player_name() const
+{
+    for (const auto* name : fake_player_names) {
+        const bool used =
+            any_of(begin(slots_), end(slots_), [&](const auto& slot) {
+                return slot.active() && slot.player->name() == name;
+            });
+        if (!used) {
+            return name;
+        }
+    }
+    return fake_player_names.back();
 }
 
 void world_t::adjust_players()
 {
     if (active_real_players() == 0) {
-        if (!fake_players_.empty()) {
-            spdlog::info("no more active players, removing all fake players");
-            fake_players_.clear();
+        if (const auto fakes = fake_players(); fakes > 0) {
+            log_count_event(
+                event_kind_t::fake_players_cleared,
+                static_cast<std::int64_t>(fakes));
+            for (auto& slot : slots_) {
+                if (slot.player && slot.player->fake()) {
+                    remove_player(slot);
+                }
+            }
         }
         return;
     }
 
+    const auto active_players =
+        count_if(begin(slots_), end(slots_), [](const auto& slot) {
+            return slot.active();
+        });
     auto missing = static_cast<ssize_t>(max_players)
-                   - static_cast<ssize_t>(players_.size());
+                   - static_cast<ssize_t>(active_players);
     if (missing > 0) {
-        spdlog::debug("adding {} fake players", missing);
+        log_count_event(event_kind_t::fake_players_added, missing);
         for (int i = 0; i < missing; ++i) {
-            fake_players_.emplace_back(register_player(
-                uuid_generator_(), get_fake_player_name(players_), true));
+            add_player(uuid_generator_(), fake_player_name(), true);
         }
     }
     else if (missing < 0) {
         auto nr_to_remove =
-            std::min(-missing, static_cast<ssize_t>(fake_players_.size()));
-        spdlog::debug("removing {} fake players", nr_to_remove);
-        for (int i = 0; i < nr_to_remove; ++i) {
-            fake_players_.pop_back();
+            std::min(-missing, static_cast<ssize_t>(fake_players()));
+        log_count_event(event_kind_t::fake_players_removed, nr_to_remove);
+        // the most recent bots leave first
+        for (auto it = rbegin(slots_); nr_to_remove > 0 && it != rend(slots_);
+             ++it) {
+            if (it->player && it->player->fake()) {
+                remove_player(*it);
+                --nr_to_remove;
+            }
         }
     }
 }
 
 void world_t::run()
 {
-    net::co_spawn(
-        ioc_,
-        [self = shared_from_this()]() -> net::awaitable<void> {
-            co_await self->update_loop();
-        },
-        net::detached);
-    net::co_spawn(
-        ioc_,
-        [self = shared_from_this()]() -> net::awaitable<void> {
-            co_await self->check_idle_players_loop();
-        },
-        net::detached);
+    auto& scheduler = tick_scheduler_t::of(ioc_.get_executor());
+    scheduler.add(
+        [self = shared_from_this()]() { self->timed_tick(); },
+        estimate_tick_cost(ioc_));
+    scheduler_ = &scheduler;
+}
+
+world_t::clock_t::duration world_t::estimate_tick_cost(net::io_context& ioc)
+{
+    // a full world of bots apart from the real ones, whose state is
+    // serialized for each player as the sessions do, nothing exported
+    timing_wheel_t timing_wheel;
+    world_t probe{ioc, timing_wheel};
+    for (std::size_t i = 0; i < max_players; ++i) {
+        probe.add_player(
+            probe.uuid_generator_(), probe.fake_player_name(), true);
+    }
+
+    const auto start = clock_t::now();
+    for (int i = 0; i < warm_up_ticks; ++i) {
+        probe.update(refresh_dt);
+        for (const auto& slot : probe.slots_) {
+            if (slot.active()) {
+                probe.encode_state(&*slot.player);
+            }
+        }
+    }
+    return (clock_t::now() - start) / warm_up_ticks;
 }
 
 nlohmann::json world_t::game_state_for_player(const player_handle_t& player)
+{
+    SD_TRACE_SCOPE("world_t::game_state_for_player");
+    return game_state(player.get());
+}
+
+std::string_view world_t::encode_state_for_player(
+    const player_handle_t& player)
+{
+    SD_TRACE_SCOPE("world_t::encode_state_for_player");
+    const auto start = clock_t::now();
+    const auto state = encode_state(player.get());
+    if (scheduler_ != nullptr) {
+        // from the session timers, on behalf of the ticks
+        scheduler_->add_busy(clock_t::now() - start);
+    }
+    return state;
+}
+
+void world_t::add_spectator(std::weak_ptr<spectator_t> spectator)
+{
+    spectators_.push_back(std::move(spectator));
+}
+
+void world_t::broadcast_to_spectators()
+{
+    if (spectators_.empty()) {
+        return;
+    }
+
+    SD_TRACE_SCOPE("world_t::broadcast_to_spectators");
+    // encoded once, whatever the number of spectators
+    const auto frame =
+        std::make_shared<const std::string>(encode_state(nullptr));
+    auto end_it = std::remove_if(
+        begin(spectators_), end(spectators_), [&](const auto& weak) {
+            auto spectator = weak.lock();
+            if (!spectator) {
+                return true;
+            }
+            spectator->on_frame(frame);
+            return false;
+        });
+    spectators_.erase(end_it, end(spectators_));
+}
+
+void world_t::export_to(shm_exporter_t& exporter, std::size_t index)
+{
+    exporter_ = &exporter;
+    export_index_ = index;
+}
+
+void world_t::export_snapshot()
+{
+    SD_TRACE_SCOPE("world_t::export_snapshot");
+    auto& snapshot = exporter_->begin_snapshot(export_index_, tick_);
+    snapshot.tick = tick_;
+    snapshot.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+
+    std::uint32_t count = 0;
+    for (const auto& slot : slots_) {
+        if (!slot.active()) {
+            continue;
+        }
+        const auto& p = *slot.player;
+        auto& out = snapshot.players[count++];
+        std::copy(p.id().begin(), p.id().end(), out.id.begin());
+        const auto name = p.name();
+        std::copy(name.begin(), name.end(), out.name.begin());
+        out.name_size = static_cast<std::uint8_t>(name.size());
+        out.flags = static_cast<std::uint8_t>(
+            (p.alive() ? shm_player_alive : shm_player_flags_t{})
+            | (p.fake() ? shm_player_fake : shm_player_flags_t{}));
+        out.x = p.state().x;
+        out.y = p.state().y;
+        out.dx = p.state().dx;
+        out.dy = p.state().dy;
+        out.ddx = p.state().ddx;
+        out.ddy = p.state().ddy;
+        out.score = p.score();
+        out.best_score = p.best_score();
+    }
+    snapshot.player_count = count;
+
+    exporter_->publish_snapshot(export_index_, tick_);
+}
+
+nlohmann::json world_t::game_state(const player_t* me) const
 {
     nlohmann::json state = {
-        {"players", nlohmann::json::array()}, {"game_over", false}};
+        {"players", nlohmann::json::array()},
+        {"game_over", false},
+        {"tick", tick_}};
 
-    for (const auto& p_ptr : players_) {
-        const auto& p = *p_ptr;
-        const bool is_me = p == *player;
+    for (const auto& slot : slots_) {
+        if (!slot.active()) {
+            continue;
+        }
+        const auto& p = *slot.player;
+        const bool is_me = me != nullptr && p == *me;
         if (is_me && !p.alive()) {
             state["game_over"] = true;
         }
@@ -211,49 +427,85 @@ nlohmann::json world_t::game_state_for_player(const player_handle_t& player)
     return state;
 }
 
-net::awaitable<void> world_t::update_loop()
+std::string_view world_t::encode_state(const player_t* me)
 {
-    auto executor = co_await net::this_coro::executor;
-    net::steady_timer timer{executor};
-    timer.expires_from_now(std::chrono::seconds{0});
-
-    while (true) {
-        update(world_t::refresh_dt);
-        timer.expires_at(timer.expires_at() + refresh_dt);
-        co_await timer.async_wait(net::use_awaitable);
+    state_writer_.begin(me != nullptr && !me->alive());
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+        const auto& slot = slots_[i];
+        if (!slot.active()) {
+            continue;
+        }
+        const auto& p = *slot.player;
+        state_writer_.add_player(i, p, me != nullptr && p == *me);
     }
+    return state_writer_.end(tick_);
 }
 
-net::awaitable<void> world_t::check_idle_players_loop()
+void world_t::timed_tick()
 {
-    auto executor = co_await net::this_coro::executor;
-    net::steady_timer timer{executor};
-    timer.expires_from_now(std::chrono::seconds{0});
+    constexpr std::int64_t ticks_per_report = tick_stats_period / refresh_dt;
+
+    const auto tick_start = clock_t::now();
+    tick();
+    const auto tick_time = clock_t::now() - tick_start;
+
+    total_tick_time_ += tick_time;
+    max_tick_time_ =
+        std::max<std::chrono::nanoseconds>(max_tick_time_, tick_time);
+    if (++timed_ticks_ == ticks_per_report) {
+        log_tick_stats(
+            timed_ticks_, total_tick_time_ / timed_ticks_, max_tick_time_);
+        log_input_stats(
+            static_cast<std::int64_t>(inputs_received_),
+            static_cast<std::int64_t>(inputs_applied_));
+        log_latency_stats(
+            event_kind_t::ping_rtt_stats, latency_stats_.ping_rtt);
+        log_latency_stats(
+            event_kind_t::input_latency_stats,
+            latency_stats_.input_to_broadcast);
+        log_latency_stats(
+            event_kind_t::ack_latency_stats, latency_stats_.broadcast_to_ack);
+        latency_stats_.reset();
+        timed_ticks_ = 0;
+        total_tick_time_ = max_tick_time_ = {};
+        inputs_received_ = inputs_applied_ = 0;
+    }
+}
 
-    while (true) {
-        check_idle_players();
-        timer.expires_at(timer.expires_at() + check_idle_dt);
-        co_await timer.async_wait(net::use_awaitable);
+void world_t::tick()
+{
+    ++tick_;
+    update(world_t::refresh_dt);
+    broadcast_to_spectators();
+    if (exporter_ != nullptr) {
+        export_snapshot();
     }
 }
 
 void world_t::update(std::chrono::nanoseconds dt)
 {
+    SD_TRACE_SCOPE("world_t::update");
+
+    apply_inputs();
+
     // update player positions
-    for (auto& p : players_) {
-        if (!p->alive()) {
+    for (auto& slot : slots_) {
+        if (!slot.active() || !slot.player->alive()) {
             continue;
         }
-        if (p->fake()) {
-            update_fake_player_dd(*p);
+        if (slot.player->fake()) {
+            update_fake_player_dd(*slot.player);
         }
-        p->update_pos(dt);
+        slot.player->update_pos(dt);
     }
 
     // check for collisions
-    for (auto player_it = begin(players_); player_it != end(players_);
+    for (auto player_it = begin(slots_); player_it != end(slots_);
          ++player_it) {
-        auto& player = **player_it;
+        if (!player_it->active()) {
+            continue;
+        }
+        auto& player = *player_it->player;
         if (!player.alive()) {
             continue;
         }
@@ -265,9 +517,12 @@ void world_t::update(std::chrono::nanoseconds dt)
 
         // compute collisions
         for (auto other_it = ++decltype(player_it)(player_it);
-             other_it != end(players_);
+             other_it != end(slots_);
              ++other_it) {
-            auto& other = **other_it;
+            if (!other_it->active()) {
+                continue;
+            }
+            auto& other = *other_it->player;
             if (!other.alive() || !player.collides(other)) {
                 continue;
             }
@@ -284,15 +539,42 @@ void world_t::update(std::chrono::nanoseconds dt)
     }
 
     // respawn killed fake players
-    for (const auto& fake_player : fake_players_) {
-        if (!fake_player->alive()) {
-            fake_player->respawn();
+    for (auto& slot : slots_) {
+        if (slot.active() && slot.player->fake() && !slot.player->alive()) {
+            slot.player->respawn();
+        }
+    }
+}
+
+void world_t::apply_inputs()
+{
+    // inputs are applied once per tick, all at the same time,
+    // intermediate inputs received since the last tick are dropped
+    input_slot_t::input_t input{};
+    for (auto& player_slot : slots_) {
+        if (!player_slot.active()) {
+            continue;
+        }
+        auto& p = player_slot.player;
+        auto& slot = p->input();
+        if (!slot.consume(input)) {
+            continue;
+        }
+        inputs_received_ += input.received;
+        if (input.has_dd) {
+            p->set_dd(input.ddx, input.ddy);
+            ++inputs_applied_;
+        }
+        if (input.respawn && !p->alive()) {
+            p->respawn();
         }
     }
 }
 
 void world_t::update_fake_player_dd(player_t& p)
 {
+    SD_TRACE_SCOPE("world_t::update_fake_player_dd");
+
     constexpr double emergency_dist = 0.15;
     const auto l1_dist_to = [&p](double x, double y) {
         return std::abs(p.state().x - x) + std::abs(p.state().y - y);
@@ -304,8 +586,11 @@ void world_t::update_fake_player_dd(player_t& p)
     double closest_y = 0.5; // NOLINT(*-magic-numbers)
     double closest_distance = l1_dist_to(closest_x, closest_y);
 
-    for (const auto& other_ptr : players_) {
-        auto& other = *other_ptr;
+    for (const auto& slot : slots_) {
+        if (!slot.active()) {
+            continue;
+        }
+        const auto& other = *slot.player;
         if (p == other) {
             continue;
         }
@@ -341,21 +626,17 @@ void world_t::update_fake_player_dd(player_t& p)
         fake_player_speed_factor * dy * player_t::max_dd);
 }
 
-void world_t::check_idle_players()
+void world_t::expire_reservation(slot_t& slot)
 {
-    const auto remove_from = clock_t::now() - idle_duration;
-    auto end_it = std::remove_if(
-        begin(idle_players_), end(idle_players_), [&](const auto& p) {
-            if (p.from < remove_from) {
-                spdlog::info(
-                    "unregistering player {} ({})",
-                    p.player->name(),
-                    to_string(p.player->id()));
-                return true;
-            }
-            return false;
-        });
-    idle_players_.erase(end_it, end(idle_players_));
+    log_player_event(
+        event_kind_t::player_unregistered,
+        slot.player->id(),
+        slot.player->name());
+    remove_player(slot);
+
+    if (places_available_handler_) {
+        places_available_handler_();
+    }
 }
 
 } // sd
@@ -1,8 +1,8 @@
 #pragma once
 
 #include <future>
-#include <list>
 #include <memory>
+#include <optional>
 #include <random>
 #include <string_view>
 #include <vector>
@@ -12,6 +12,11 @@
 #include <spdlog/spdlog.h>
 
 #include "config.h"
+#include "latency_histogram.h"
+#include "player_handle.h"
+#include "state_writer.h"
+#include "tick_scheduler.h"
+#include "timing_wheel.h"
 
 namespace sd {
 
@@ -20,11 +25,37 @@ public:
     player_already_registered() : runtime_error{"player already registered"} {}
 };
 
-class world_t : public std::enable_shared_from_this<world_t> {
+class world_full : public std::runtime_error {
 public:
-    static constexpr auto refresh_dt = std::chrono::milliseconds{20};
+    world_full() : runtime_error{"world is full"} {}
+};
 
+// Read-only observer of a world, it receives one snapshot per tick,
+// encoded once and shared by all the spectators of the world
+class spectator_t {
+public:
+    virtual ~spectator_t() = default;
+    virtual void on_frame(const frame_t& frame) = 0;
+};
+
+class world_t : public std::enable_shared_from_this<world_t> {
+public:
+    static constexpr auto refresh_dt = tick_scheduler_t::period;
+    static constexpr std::size_t max_players = 8;
+    // an IDLE player keeps a reserved spot in the world
+    // this means he can reconnect to play with the same
+    // players and will keep his score
+    // In the meantime, a bot takes his place
+    static constexpr auto idle_duration = std::chrono::minutes{5};
+    // idle players plus active players, bots included, never exceed
+    // twice the number of places, all the slots are allocated upfront
+    static constexpr std::size_t capacity = 2 * max_players;
+
+    // runs in real time, see run()
     world_t(net::io_context& ioc);
+    // for a driver calling tick() and advancing the timing wheel itself,
+    // one step per timing_wheel_t::resolution of simulated time
+    world_t(net::io_context& ioc, timing_wheel_t& timing_wheel);
     ~world_t();
 
     world_t(const world_t&) = delete;
@@ -32,42 +63,94 @@ public:
     world_t& operator=(const world_t&) = delete;
     world_t& operator=(world_t&&) = delete;
 
+    // ticks in real time from the tick scheduler of the io_context,
+    // throws tick_period_saturated if the scheduler can't take the cost
+    // of its ticks, estimated from a few ticks of a full world of bots,
+    // the serialization of the state for each player included
     void run();
+    // one step of the simulation, run periodically by run()
+    void tick();
+    // number of the last tick, sent with the state
+    [[nodiscard]] std::uint64_t current_tick() const { return tick_; }
 
     nlohmann::json game_state_for_player(const player_handle_t& player);
+    // same message as game_state_for_player(player).dump(),
+    // valid until the next call
+    std::string_view encode_state_for_player(const player_handle_t& player);
     player_handle_t register_player(
         const player_id_t& player_id,
         std::string_view player_name);
     std::size_t real_players() const;
     std::size_t active_real_players() const;
     std::size_t available_places() const;
+    bool has_reservation(const player_id_t& player_id) const;
+
+    // called when idle reservations expired and places became available
+    void on_places_available(std::function<void()> handler);
+
+    // spectators are removed once expired
+    void add_spectator(std::weak_ptr<spectator_t> spectator);
+
+    // publishes a snapshot per tick as the world `index` of the
+    // exporter, which must outlive the ticks of the world
+    void export_to(shm_exporter_t& exporter, std::size_t index);
+
+    // shared by the players of the world
+    std::mt19937& random_generator() { return rnd_gen_; }
+
+    // recorded by the sessions, logged with the tick stats
+    latency_stats_t& latency_stats() { return latency_stats_; }
 
 private:
+    friend class player_handle_t;
     using clock_t = std::chrono::steady_clock;
-    struct idle_player {
-        clock_t::time_point from;
-        std::unique_ptr<player_t> player;
-    };
+    struct slot_t;
 
-    player_handle_t register_player(
+    slot_t& add_player(
         const player_id_t& player_id,
         std::string_view player_name,
         bool fake);
-    void unregister_player(const player_t& player);
+    void remove_player(slot_t& slot);
+    player_t* find_player(std::uint32_t index, std::uint32_t generation);
+    void unregister_player(std::uint32_t index, std::uint32_t generation);
+    slot_t* find_slot(const player_id_t& player_id);
+    std::size_t fake_players() const;
+    std::string_view fake_player_name() const;
     void adjust_players();
+    nlohmann::json game_state(const player_t* me) const;
+    std::string_view encode_state(const player_t* me);
+    void broadcast_to_spectators();
+    void export_snapshot();
 
-    net::awaitable<void> update_loop();
-    net::awaitable<void> check_idle_players_loop();
+    static clock_t::duration estimate_tick_cost(net::io_context& ioc);
+    // tick() from the scheduler, with the tick stats
+    void timed_tick();
 
     void update(std::chrono::nanoseconds dt);
+    void apply_inputs();
     void update_fake_player_dd(player_t& player);
-    void check_idle_players();
+    // the reservation of an idle player expired
+    void expire_reservation(slot_t& slot);
 
     net::io_context& ioc_;
-    std::vector<std::unique_ptr<player_t>> players_;
-    std::vector<idle_player> idle_players_;
-    std::list<player_handle_t> fake_players_;
-    boost::uuids::random_generator uuid_generator_;
+    timing_wheel_t& timing_wheel_;
+    std::vector<slot_t> slots_;
+    std::mt19937 rnd_gen_;
+    boost::uuids::basic_random_generator<std::mt19937> uuid_generator_;
+    std::function<void()> places_available_handler_;
+    std::vector<std::weak_ptr<spectator_t>> spectators_;
+    // set by run(), the serialization of the state counts in its load
+    tick_scheduler_t* scheduler_{nullptr};
+    shm_exporter_t* exporter_{nullptr};
+    std::size_t export_index_{0};
+    state_writer_t state_writer_{capacity};
+    std::uint64_t tick_{0};
+    std::int64_t timed_ticks_{0};
+    std::chrono::nanoseconds total_tick_time_{0};
+    std::chrono::nanoseconds max_tick_time_{0};
+    latency_stats_t latency_stats_;
+    std::uint64_t inputs_received_{0};
+    std::uint64_t inputs_applied_{0};
 };
 
 } // sd